@@ -0,0 +1,280 @@
+#include <benchmark/benchmark.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/ExpressionCache.h"
+#include "../src/Model/GraphData.h"
+#include "../src/Model/GraphFunction.h"
+#include "../src/Model/GraphFunctionSet.h"
+#include "../src/Model/GraphTileCache.h"
+#include "../src/Model/InfixToRPN.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Builds an infix expression with the given number of terms, cycling
+// through operators, functions and parentheses.
+std::string makeExpression(int terms) {
+    static const char* pieces[] = {"x * 2", "sin(x)", "(x - 3) / 4", "sqrt(abs(x))", "x ^ 2"};
+    static const char* joins[] = {" + ", " - ", " * "};
+    std::string expr;
+    for (int i = 0; i < terms; ++i) {
+        if (i > 0) {
+            expr += joins[i % 3];
+        }
+        expr += pieces[i % 5];
+    }
+    return expr;
+}
+
+void BM_InfixToRPNConvert(benchmark::State& state) {
+    std::string expr = makeExpression(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(RPN::InfixToRPN::convert(expr));
+    }
+    state.SetBytesProcessed(state.iterations() * expr.size());
+}
+BENCHMARK(BM_InfixToRPNConvert)->RangeMultiplier(8)->Range(1, 4096);
+
+// The same conversion through a reused parser, which allocates nothing
+// once its buffers have grown
+void BM_InfixToRPNParse(benchmark::State& state) {
+    std::string expr = makeExpression(static_cast<int>(state.range(0)));
+    RPN::InfixToRPN parser;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.parse(expr));
+    }
+    state.SetBytesProcessed(state.iterations() * expr.size());
+}
+BENCHMARK(BM_InfixToRPNParse)->RangeMultiplier(8)->Range(1, 4096);
+
+// An expression repeating its subexpressions, through the interpreter
+// and through the batch evaluator
+void BM_GraphFunctionSharedSubexpressions(benchmark::State& state) {
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    function.SetExpression("sin(x) * sin(x) + cos(x) * cos(x) + sin(x) * cos(x) + x ^ 2 * 1");
+    bool batch = state.range(0) != 0;
+    std::vector<double> xs(1024), ys(1024);
+    for (size_t i = 0; i < xs.size(); ++i) {
+        xs[i] = -5.0 + 0.01 * i;
+    }
+
+    for (auto _ : state) {
+        if (batch) {
+            function.EvaluateBatch(xs.data(), ys.data(), xs.size());
+        } else {
+            for (size_t i = 0; i < xs.size(); ++i) {
+                ys[i] = function.EvaluateAtPoint(xs[i]);
+            }
+        }
+        benchmark::DoNotOptimize(ys.data());
+    }
+    state.SetItemsProcessed(state.iterations() * xs.size());
+}
+BENCHMARK(BM_GraphFunctionSharedSubexpressions)->Arg(0)->Arg(1);
+
+// Switching the plotted expression: compiled from scratch each time, or
+// found in the expression cache
+void BM_GraphFunctionSetExpression(benchmark::State& state) {
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    RPN::ExpressionCache cache;
+    function.SetExpressionCache(&cache);
+    bool cached = state.range(0) != 0;
+    const std::string expr = "sin(x) * exp(x / 10) + sqrt(abs(x)) - ln(x * x + 1)";
+
+    for (auto _ : state) {
+        if (!cached) {
+            cache.Clear();
+        }
+        benchmark::DoNotOptimize(function.SetExpression(expr));
+    }
+}
+BENCHMARK(BM_GraphFunctionSetExpression)->Arg(0)->Arg(1);
+
+void BM_GraphFunctionEvaluate(benchmark::State& state) {
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    function.SetExpression("sin(x) * x + 2");
+    int points = static_cast<int>(state.range(0));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(function.Evaluate(-10.0, 10.0, points));
+    }
+    state.SetItemsProcessed(state.iterations() * points);
+}
+BENCHMARK(BM_GraphFunctionEvaluate)->Arg(1000)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+// A 2000-pixel view panned by a fraction of its width per frame: the tile
+// cache only evaluates what scrolls into view, against a full resample
+void BM_GraphViewportPan(benchmark::State& state) {
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    function.SetExpression("sin(x) * exp(x / 10) + sqrt(abs(x)) - ln(x * x + 1)");
+    RPN::GraphTileCache cache;
+    bool cached = state.range(0) != 0;
+    const double width = 20.0, pixel = width / 2000.0;
+
+    double offset = 0.0;
+    for (auto _ : state) {
+        offset += width * 0.01;
+        if (cached) {
+            benchmark::DoNotOptimize(cache.Sample(function, offset, offset + width, pixel));
+        } else {
+            benchmark::DoNotOptimize(function.Evaluate(offset, offset + width, 2000));
+        }
+    }
+    state.counters["evaluations/frame"] = benchmark::Counter(
+        static_cast<double>(function.GetEvaluationCount()) / state.iterations());
+}
+BENCHMARK(BM_GraphViewportPan)->Arg(0)->Arg(1);
+
+// Twelve curves that share sin(x) and sqrt(abs(x)), evaluated one by one
+// and as a set over one grid with the shared parts computed once
+void BM_GraphFunctionSet(benchmark::State& state) {
+    CalculatorModel model;
+    std::vector<std::string> expressions;
+    for (int k = 1; k <= 12; ++k) {
+        expressions.push_back("sin(x) * " + std::to_string(k) + " + sqrt(abs(x)) - exp(x / 10)");
+    }
+    std::vector<double> x(4096);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = -10.0 + 20.0 * i / x.size();
+    }
+    std::vector<std::vector<double>> y(expressions.size(), std::vector<double>(x.size()));
+    std::vector<double*> outputs;
+    for (auto& column : y) {
+        outputs.push_back(column.data());
+    }
+
+    RPN::GraphFunctionSet set(&model);
+    set.SetExpressions(expressions);
+    std::vector<RPN::GraphFunction> separate;
+    for (const auto& expr : expressions) {
+        separate.emplace_back(&model);
+        separate.back().SetExpression(expr);
+    }
+
+    bool shared = state.range(0) != 0;
+    for (auto _ : state) {
+        if (shared) {
+            set.EvaluateBatch(x.data(), outputs.data(), x.size());
+        } else {
+            for (size_t k = 0; k < separate.size(); ++k) {
+                separate[k].EvaluateBatch(x.data(), outputs[k], x.size());
+            }
+        }
+        benchmark::DoNotOptimize(outputs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * x.size() * expressions.size());
+}
+BENCHMARK(BM_GraphFunctionSet)->Arg(0)->Arg(1);
+
+// Per-point interpreter against the SIMD batch evaluator on the same
+// transcendental-heavy expression.
+void BM_EvaluateAtPoint(benchmark::State& state) {
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    function.SetExpression("sin(x) * exp(x / 10) + sqrt(abs(x)) - ln(x * x + 1)");
+    std::vector<double> x(static_cast<size_t>(state.range(0))), y(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = -10.0 + 20.0 * i / x.size();
+    }
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < x.size(); ++i) {
+            y[i] = function.EvaluateAtPoint(x[i]);
+        }
+        benchmark::DoNotOptimize(y.data());
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+}
+BENCHMARK(BM_EvaluateAtPoint)->Arg(100000);
+
+void BM_EvaluateBatch(benchmark::State& state) {
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    function.SetExpression("sin(x) * exp(x / 10) + sqrt(abs(x)) - ln(x * x + 1)");
+    std::vector<double> x(static_cast<size_t>(state.range(0))), y(x.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = -10.0 + 20.0 * i / x.size();
+    }
+
+    for (auto _ : state) {
+        function.EvaluateBatch(x.data(), y.data(), x.size());
+        benchmark::DoNotOptimize(y.data());
+    }
+    state.SetItemsProcessed(state.iterations() * x.size());
+    state.SetLabel(RPN::BatchEvaluator::instructionSet());
+}
+BENCHMARK(BM_EvaluateBatch)->Arg(100000);
+
+// Adaptive sampling at an 800x600 plot resolution; the evaluations
+// counter shows the saving against the 1000 uniform samples above.
+void BM_GraphFunctionEvaluateAdaptive(benchmark::State& state) {
+    static const char* expressions[] = {"sin(x) * x + 2", "tan(x)", "sqrt(x)"};
+    CalculatorModel model;
+    RPN::GraphFunction function(&model);
+    function.SetExpression(expressions[state.range(0)]);
+    RPN::SamplingOptions options;
+    options.xPixel = 20.0 / 800;
+    options.yPixel = 20.0 / 600;
+
+    size_t evaluations = 0;
+    for (auto _ : state) {
+        function.ResetEvaluationCount();
+        benchmark::DoNotOptimize(function.EvaluateAdaptive(-10.0, 10.0, options));
+        evaluations = function.GetEvaluationCount();
+    }
+    state.counters["evaluations"] = static_cast<double>(evaluations);
+    state.SetLabel(expressions[state.range(0)]);
+}
+BENCHMARK(BM_GraphFunctionEvaluateAdaptive)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+// The vectorized rescan that follows SetData
+void BM_GraphDataRescanBounds(benchmark::State& state) {
+    size_t points = static_cast<size_t>(state.range(0));
+    std::vector<double> xs(points), ys(points);
+    for (size_t i = 0; i < points; ++i) {
+        xs[i] = i * 0.001;
+        ys[i] = std::sin(i * 0.001);
+    }
+    RPN::GraphData data;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        data.SetData(xs, ys);
+        state.ResumeTiming();
+        double xMin, xMax, yMin, yMax;
+        data.GetBounds(xMin, xMax, yMin, yMax);
+        benchmark::DoNotOptimize(xMin);
+        benchmark::DoNotOptimize(yMax);
+    }
+    state.SetItemsProcessed(state.iterations() * points);
+}
+BENCHMARK(BM_GraphDataRescanBounds)->Arg(100000)->Arg(1000000);
+
+// Picking what to draw each frame: flat in the series size, since
+// SetData has already built the pyramid
+void BM_GraphDataLevelOfDetail(benchmark::State& state) {
+    size_t points = static_cast<size_t>(state.range(0));
+    std::vector<double> xs(points), ys(points);
+    for (size_t i = 0; i < points; ++i) {
+        xs[i] = i * 0.001;
+        ys[i] = std::sin(i * 0.001);
+    }
+    RPN::GraphData data;
+    data.SetData(std::move(xs), std::move(ys));
+
+    size_t drawn = 0;
+    for (auto _ : state) {
+        RPN::GraphData::View view = data.GetLevelOfDetail(0.0, points * 0.001, 1000);
+        benchmark::DoNotOptimize(view.x);
+        drawn = view.count;
+    }
+    state.counters["drawn"] = static_cast<double>(drawn);
+}
+BENCHMARK(BM_GraphDataLevelOfDetail)->Arg(10000)->Arg(1000000)->Arg(10000000);
+
+}
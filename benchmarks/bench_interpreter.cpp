@@ -0,0 +1,107 @@
+#include <benchmark/benchmark.h>
+#include "../src/Model/CalculatorModel.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+// Pushes operands the builtin accepts without error.
+void pushOperands(CalculatorModel& model, RPN::Builtin op) {
+    switch (op) {
+        case RPN::Builtin::Pick:
+            model.pushValue(2.0);
+            model.pushValue(3.0);
+            model.pushValue(1.0);
+            break;
+        case RPN::Builtin::Roll:
+        case RPN::Builtin::Rot:
+            model.pushValue(2.0);
+            model.pushValue(3.0);
+            model.pushValue(2.0);
+            break;
+        default:
+            model.pushValue(2.0);
+            model.pushValue(3.0);
+            break;
+    }
+}
+
+// Each iteration pushes operands, runs the builtin and clears the stack.
+void BM_ExecuteOperation(benchmark::State& state) {
+    auto op = static_cast<RPN::Builtin>(state.range(0));
+    std::string name = RPN::builtinName(op);
+    CalculatorModel model;
+
+    for (auto _ : state) {
+        pushOperands(model, op);
+        benchmark::DoNotOptimize(model.executeOperation(name));
+        model.clear();
+    }
+    state.SetLabel(name);
+}
+BENCHMARK(BM_ExecuteOperation)->DenseRange(0, static_cast<int>(RPN::Builtin::Count) - 1);
+
+// Call tree of depth N: level k calls level k-1 twice, so one call of the
+// top function runs 2^N leaf bodies through N levels of nesting.
+void BM_ExecuteFunctionNested(benchmark::State& state) {
+    int depth = static_cast<int>(state.range(0));
+    CalculatorModel model;
+    model.defineFunction("f0", {"1", "+"});
+    for (int i = 1; i <= depth; ++i) {
+        std::string callee = "f" + std::to_string(i - 1);
+        model.defineFunction("f" + std::to_string(i), {callee, callee});
+    }
+    std::string top = "f" + std::to_string(depth);
+
+    for (auto _ : state) {
+        model.pushValue(0.0);
+        benchmark::DoNotOptimize(model.executeFunction(top));
+        model.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t(1) << depth));
+}
+BENCHMARK(BM_ExecuteFunctionNested)->DenseRange(0, 10, 2);
+
+void BM_ExecuteFunctionFlat(benchmark::State& state) {
+    CalculatorModel model;
+    model.defineFunction("poly", {"dup", "dup", "*", "3", "*", "swap", "2", "*", "+", "1", "+"});
+
+    for (auto _ : state) {
+        model.pushValue(1.5);
+        benchmark::DoNotOptimize(model.executeFunction("poly"));
+        model.clear();
+    }
+}
+BENCHMARK(BM_ExecuteFunctionFlat);
+
+void BM_EnterInputNumber(benchmark::State& state) {
+    CalculatorModel model;
+    for (auto _ : state) {
+        model.setInputBuffer("3.14159");
+        benchmark::DoNotOptimize(model.enterInput());
+    }
+}
+BENCHMARK(BM_EnterInputNumber);
+
+void BM_EnterInputOperation(benchmark::State& state) {
+    CalculatorModel model;
+    for (auto _ : state) {
+        model.pushValue(2.0);
+        model.setInputBuffer("sqrt");
+        benchmark::DoNotOptimize(model.enterInput());
+    }
+}
+BENCHMARK(BM_EnterInputOperation);
+
+void BM_ExecuteScript(benchmark::State& state) {
+    CalculatorModel model;
+    const std::string script = "3 4 + 2 * dup sqrt swap drop 1.5e2 max";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model.executeScript(script));
+        model.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 11);
+}
+BENCHMARK(BM_ExecuteScript);
+
+}
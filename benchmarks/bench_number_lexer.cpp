@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+#include "../src/Model/NumberLexer.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+// Typical RPN token mix: mostly numbers with some operation names.
+const std::vector<std::string> tokens = {
+    "3", "4", "+", "2.5", "*", "dup", "1e-3", "sqrt", "-17", "swap", "0x1f", "sin"
+};
+
+// Baseline: the old exception-driven detection.
+void BM_StodWithCatch(benchmark::State& state) {
+    for (auto _ : state) {
+        for (const auto& token : tokens) {
+            double value = 0.0;
+            try {
+                value = std::stod(token);
+            } catch (const std::exception&) {
+            }
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_StodWithCatch);
+
+void BM_ParseNumber(benchmark::State& state) {
+    for (auto _ : state) {
+        for (const auto& token : tokens) {
+            double value = 0.0;
+            benchmark::DoNotOptimize(RPN::parseNumber(token, value));
+            benchmark::DoNotOptimize(value);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_ParseNumber);
+
+}
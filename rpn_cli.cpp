@@ -0,0 +1,149 @@
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "src/Model/CalculatorModel.h"
+
+namespace {
+
+struct Options {
+    bool printStack = false;
+    bool quiet = false;
+    bool throughput = false;
+    bool resetEachLine = false;
+    std::vector<std::string> files;
+};
+
+struct Totals {
+    size_t lines = 0;
+    size_t tokens = 0;
+    size_t errors = 0;
+};
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [file...]\n"
+              << "Evaluates RPN programs line by line from files or stdin.\n\n"
+              << "  -s, --stack       print the final stack instead of each line's result\n"
+              << "  -q, --quiet       only report errors\n"
+              << "  -t, --throughput  report lines/sec and tokens/sec on stderr (implies -q)\n"
+              << "  -r, --reset       clear the stack before every line\n"
+              << "  -h, --help        show this help\n";
+}
+
+void writeValue(std::string& out, double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void processStream(std::istream& in, const std::string& name, CalculatorModel& model,
+                   const Options& options, Totals& totals) {
+    std::string line;
+    std::string out;
+    size_t lineNumber = 0;
+
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (options.resetEachLine) {
+            model.clear();
+        }
+
+        CalculatorModel::ScriptResult result = model.executeScript(line);
+        ++totals.lines;
+        totals.tokens += result.tokensExecuted;
+
+        if (!result.success) {
+            ++totals.errors;
+            std::cerr << name << ":" << lineNumber << ":" << (result.errorOffset + 1)
+                      << ": error: " << model.getError() << "\n";
+            model.clearError();
+            continue;
+        }
+
+        // A blank line or one that only defines functions leaves the
+        // previous result on top; don't repeat it
+        if (!options.quiet && !options.printStack && result.tokensExecuted > result.functionsDefined &&
+            !model.getStack().empty()) {
+            out.clear();
+            writeValue(out, model.getStack().back());
+            out += '\n';
+            std::cout << out;
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!std::strcmp(arg, "-s") || !std::strcmp(arg, "--stack")) {
+            options.printStack = true;
+        } else if (!std::strcmp(arg, "-q") || !std::strcmp(arg, "--quiet")) {
+            options.quiet = true;
+        } else if (!std::strcmp(arg, "-t") || !std::strcmp(arg, "--throughput")) {
+            options.throughput = true;
+            options.quiet = true;
+        } else if (!std::strcmp(arg, "-r") || !std::strcmp(arg, "--reset")) {
+            options.resetEachLine = true;
+        } else if (!std::strcmp(arg, "-h") || !std::strcmp(arg, "--help")) {
+            printUsage(argv[0]);
+            return 0;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            options.files.push_back(arg);
+        }
+    }
+
+    CalculatorModel model;
+    Totals totals;
+    auto start = std::chrono::steady_clock::now();
+
+    if (options.files.empty()) {
+        processStream(std::cin, "<stdin>", model, options, totals);
+    }
+    for (const auto& file : options.files) {
+        if (file == "-") {
+            processStream(std::cin, "<stdin>", model, options, totals);
+            continue;
+        }
+        std::ifstream in(file);
+        if (!in) {
+            std::cerr << "Cannot open " << file << "\n";
+            return 1;
+        }
+        processStream(in, file, model, options, totals);
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (options.printStack && !options.quiet) {
+        std::string out;
+        for (double value : model.getStack()) {
+            writeValue(out, value);
+            out += '\n';
+        }
+        std::cout << out;
+    }
+
+    if (options.throughput) {
+        double seconds = elapsed > 0.0 ? elapsed : 1e-9;
+        std::cerr << totals.lines << " lines, " << totals.tokens << " tokens, "
+                  << totals.errors << " errors in " << elapsed << " s\n"
+                  << static_cast<size_t>(totals.lines / seconds) << " lines/sec, "
+                  << static_cast<size_t>(totals.tokens / seconds) << " tokens/sec\n";
+    }
+
+    std::cout.flush();
+    return totals.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,637 @@
+#include "BatchEvaluator.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <iterator>
+#include <unordered_map>
+
+namespace RPN {
+
+namespace {
+
+using Simd::Vec;
+
+// Work limit for inlining: with shared subexpressions a call tree can
+// grow exponentially without adding nodes, so count instructions too
+constexpr size_t MAX_STEPS = 16 * BatchEvaluator::MAX_OPERATIONS;
+
+bool canFail(Builtin op) {
+    switch (op) {
+        case Builtin::Divide:
+        case Builtin::Sqrt:
+        case Builtin::Reciprocal:
+        case Builtin::Ln:
+        case Builtin::Log:
+        case Builtin::Mod:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Symbolic execution of programs into a graph: the stack holds node
+// numbers instead of values, so dup, swap and friends become renames and
+// only arithmetic creates nodes. The same operation on the same operands
+// maps to the same node, whether it recurs within a program or across
+// programs, so shared subexpressions are computed once.
+class Builder {
+public:
+    enum class Kind : uint8_t { X, CONSTANT, OPERATION };
+
+    struct Node {
+        Kind kind;
+        Builtin op;
+        uint32_t a;
+        uint32_t b;
+        double value;
+        // Programs that execute the operation, for error reporting
+        uint64_t programs;
+    };
+
+    Builder(const FunctionTable& functions, size_t stackCapacity)
+        : functions(functions), stackCapacity(stackCapacity) {
+        nodes.push_back({Kind::X, Builtin::Add, 0, 0, 0.0, 0});
+    }
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> stack;
+
+    // Runs one program as number `program`; on failure its nodes are
+    // removed again and earlier programs are unaffected.
+    bool build(const Program& program, size_t index);
+
+private:
+    const FunctionTable& functions;
+    size_t stackCapacity;
+    std::unordered_map<uint64_t, uint32_t> constantIndex;
+    std::unordered_map<uint64_t, uint32_t> operationIndex;
+    std::vector<uint32_t> callStack;
+    uint64_t bit = 0;
+    size_t steps = 0;
+    size_t operations = 0;
+    size_t constants = 0;
+
+    bool run(const Program& program);
+    void rollback(size_t mark);
+    bool push(uint32_t node);
+    uint32_t pop();
+    bool constant(double value, uint32_t& node);
+    bool constantValue(uint32_t node, double& value) const;
+    bool operation(Builtin op, uint32_t a, uint32_t b, uint32_t& node);
+    bool builtin(Builtin op);
+};
+
+bool Builder::build(const Program& program, size_t index) {
+    size_t mark = nodes.size();
+    bit = uint64_t(1) << index;
+    stack.clear();
+    callStack.clear();
+    steps = 0;
+    if (run(program) && !stack.empty()) {
+        return true;
+    }
+    rollback(mark);
+    return false;
+}
+
+void Builder::rollback(size_t mark) {
+    for (size_t i = mark; i < nodes.size(); ++i) {
+        if (nodes[i].kind == Kind::CONSTANT) {
+            --constants;
+        } else {
+            --operations;
+        }
+    }
+    nodes.resize(mark);
+    for (Node& node : nodes) {
+        node.programs &= ~bit;
+    }
+    for (auto* index : {&constantIndex, &operationIndex}) {
+        for (auto it = index->begin(); it != index->end();) {
+            it = it->second >= mark ? index->erase(it) : std::next(it);
+        }
+    }
+}
+
+bool Builder::push(uint32_t node) {
+    if (stack.size() >= stackCapacity) {
+        // The interpreter's ring buffer would evict; leave that to it
+        return false;
+    }
+    stack.push_back(node);
+    return true;
+}
+
+uint32_t Builder::pop() {
+    uint32_t node = stack.back();
+    stack.pop_back();
+    return node;
+}
+
+bool Builder::constant(double value, uint32_t& node) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = constantIndex.find(bits);
+    if (it != constantIndex.end()) {
+        node = it->second;
+        return true;
+    }
+    if (constants >= BatchEvaluator::MAX_REGISTERS) {
+        return false;
+    }
+    ++constants;
+    node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({Kind::CONSTANT, Builtin::Add, 0, 0, value, 0});
+    constantIndex.emplace(bits, node);
+    return true;
+}
+
+bool Builder::constantValue(uint32_t node, double& value) const {
+    if (nodes[node].kind != Kind::CONSTANT) {
+        return false;
+    }
+    value = nodes[node].value;
+    return true;
+}
+
+bool Builder::operation(Builtin op, uint32_t a, uint32_t b, uint32_t& node) {
+    // Addition and multiplication give the same bits either way round
+    if ((op == Builtin::Add || op == Builtin::Multiply) && b < a) {
+        std::swap(a, b);
+    }
+    // Node numbers stay below 2^16: operations and constants are capped
+    uint64_t key = (uint64_t(op) << 32) | (uint64_t(a) << 16) | b;
+    auto it = operationIndex.find(key);
+    if (it != operationIndex.end()) {
+        node = it->second;
+        nodes[node].programs |= bit;
+        return true;
+    }
+    if (operations >= BatchEvaluator::MAX_OPERATIONS) {
+        return false;
+    }
+    ++operations;
+    node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({Kind::OPERATION, op, a, b, 0.0, bit});
+    operationIndex.emplace(key, node);
+    return true;
+}
+
+bool Builder::builtin(Builtin op) {
+    uint32_t node;
+    switch (builtinArity(op)) {
+        case Arity::UNARY: {
+            if (stack.empty()) {
+                return false;
+            }
+            uint32_t a = pop();
+            return operation(op, a, a, node) && push(node);
+        }
+        case Arity::BINARY: {
+            if (stack.size() < 2) {
+                return false;
+            }
+            uint32_t b = pop();
+            uint32_t a = pop();
+            return operation(op, a, b, node) && push(node);
+        }
+        case Arity::STACK:
+            break;
+    }
+
+    size_t size = stack.size();
+    switch (op) {
+        case Builtin::Dup:
+            return size >= 1 && push(stack.back());
+        case Builtin::Drop:
+            if (size < 1) {
+                return false;
+            }
+            pop();
+            return true;
+        case Builtin::Swap:
+            if (size < 2) {
+                return false;
+            }
+            std::swap(stack[size - 1], stack[size - 2]);
+            return true;
+        case Builtin::Rot:
+            if (size < 3) {
+                return false;
+            }
+            std::rotate(stack.end() - 3, stack.end() - 2, stack.end());
+            return true;
+        case Builtin::Over:
+            return size >= 2 && push(stack[size - 2]);
+        case Builtin::Pick: {
+            // Only a literal index has the same effect for every lane
+            double n;
+            if (size < 1 || !constantValue(stack.back(), n)) {
+                return false;
+            }
+            int index = static_cast<int>(n);
+            if (index < 0 || static_cast<size_t>(index) >= size - 1) {
+                return false;
+            }
+            uint32_t picked = stack[size - 2 - index];
+            pop();
+            return push(picked);
+        }
+        case Builtin::Roll: {
+            double n;
+            if (size < 1 || !constantValue(stack.back(), n)) {
+                return false;
+            }
+            int count = static_cast<int>(n);
+            if (count <= 0 || static_cast<size_t>(count) > size - 1) {
+                return false;
+            }
+            pop();
+            std::rotate(stack.end() - count, stack.end() - 1, stack.end());
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool Builder::run(const Program& program) {
+    for (const Instruction& instruction : program) {
+        if (++steps > MAX_STEPS) {
+            return false;
+        }
+        switch (instruction.code) {
+            case OpCode::PUSH: {
+                uint32_t node;
+                if (!constant(instruction.value, node) || !push(node)) {
+                    return false;
+                }
+                break;
+            }
+            case OpCode::LOAD_X:
+                if (!push(0)) {
+                    return false;
+                }
+                break;
+            case OpCode::BUILTIN:
+                if (!builtin(static_cast<Builtin>(instruction.index))) {
+                    return false;
+                }
+                break;
+            case OpCode::COPY:
+                if (instruction.index >= stack.size() ||
+                    !push(stack[stack.size() - 1 - instruction.index])) {
+                    return false;
+                }
+                break;
+            case OpCode::SQUARE: {
+                uint32_t node;
+                if (stack.empty() || !operation(Builtin::Multiply, stack.back(), stack.back(), node)) {
+                    return false;
+                }
+                stack.back() = node;
+                break;
+            }
+            case OpCode::MULTIPLY_ADD: {
+                uint32_t product;
+                uint32_t addend;
+                uint32_t node;
+                if (stack.size() < 2 ||
+                    !operation(Builtin::Multiply, stack[stack.size() - 2], stack.back(), product) ||
+                    !constant(instruction.value, addend) || !operation(Builtin::Add, product, addend, node)) {
+                    return false;
+                }
+                pop();
+                stack.back() = node;
+                break;
+            }
+            case OpCode::CALL: {
+                uint32_t slot = instruction.index;
+                if (slot >= functions.size() || !functions.at(slot).defined ||
+                    std::find(callStack.begin(), callStack.end(), slot) != callStack.end()) {
+                    return false;
+                }
+                callStack.push_back(slot);
+                bool ok = run(functions.at(slot).code);
+                callStack.pop_back();
+                if (!ok) {
+                    return false;
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void orInto(double* errors, size_t i, Vec failed) {
+    (Vec::load(errors + i) | failed).store(errors + i);
+}
+
+// Flags the failed lanes for every program that executed the operation;
+// each program's error lanes follow the previous one's
+void flag(double* errors, uint64_t programs, size_t i, Vec failed) {
+    for (; programs; programs >>= 1, errors += BatchEvaluator::BLOCK) {
+        if (programs & 1) {
+            orInto(errors, i, failed);
+        }
+    }
+}
+
+template <typename Fn>
+void unaryLanes(const double* a, double* dst, Fn fn) {
+    for (size_t i = 0; i < BatchEvaluator::BLOCK; i += Vec::WIDTH) {
+        fn(Vec::load(a + i)).store(dst + i);
+    }
+}
+
+template <typename Fn>
+void binaryLanes(const double* a, const double* b, double* dst, Fn fn) {
+    for (size_t i = 0; i < BatchEvaluator::BLOCK; i += Vec::WIDTH) {
+        fn(Vec::load(a + i), Vec::load(b + i)).store(dst + i);
+    }
+}
+
+// Operations without a vector kernel run the <cmath> function per lane
+template <typename Fn>
+void scalarLanes(const double* a, const double* b, double* dst, Fn fn) {
+    for (size_t i = 0; i < BatchEvaluator::BLOCK; ++i) {
+        dst[i] = fn(a[i], b[i]);
+    }
+}
+
+Vec boolean(Vec mask) {
+    return mask & Vec::broadcast(1.0);
+}
+
+}
+
+const char* BatchEvaluator::instructionSet() {
+#if defined(RPN_SIMD_AVX2)
+    return "AVX2";
+#elif defined(RPN_SIMD_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+bool BatchEvaluator::compile(const Program& program, const FunctionTable& functions, size_t stackCapacity) {
+    return compile(std::vector<const Program*>{&program}, functions, stackCapacity);
+}
+
+bool BatchEvaluator::compile(const std::vector<const Program*>& programs, const FunctionTable& functions,
+                             size_t stackCapacity) {
+    compiled = false;
+    operations.clear();
+    results.assign(programs.size(), NOT_COMPILED);
+    if (programs.size() > MAX_PROGRAMS) {
+        return false;
+    }
+
+    using Kind = Builder::Kind;
+    Builder builder(functions, stackCapacity);
+    std::vector<uint32_t> resultNodes(programs.size(), 0);
+    std::vector<bool> built(programs.size(), false);
+    for (size_t k = 0; k < programs.size(); ++k) {
+        if (builder.build(*programs[k], k)) {
+            resultNodes[k] = builder.stack.back();
+            built[k] = compiled = true;
+        }
+    }
+    if (!compiled) {
+        return false;
+    }
+
+    // Keep the operations a result depends on, plus any that can fail,
+    // since the interpreter reports those even when the value is dropped
+    const auto& nodes = builder.nodes;
+    const size_t count = nodes.size();
+    std::vector<bool> needed(count, false);
+    std::vector<size_t> lastUse(count, 0);
+    for (size_t k = 0; k < programs.size(); ++k) {
+        if (built[k]) {
+            needed[resultNodes[k]] = true;
+        }
+    }
+    for (size_t i = count; i-- > 0;) {
+        const auto& node = nodes[i];
+        if (node.kind == Kind::OPERATION && (needed[i] || canFail(node.op))) {
+            needed[i] = needed[node.a] = needed[node.b] = true;
+            lastUse[node.a] = std::max(lastUse[node.a], i);
+            lastUse[node.b] = std::max(lastUse[node.b], i);
+        }
+    }
+    for (size_t k = 0; k < programs.size(); ++k) {
+        if (built[k]) {
+            lastUse[resultNodes[k]] = count;
+        }
+    }
+
+    // Register 0 holds x, then the constants, then temporaries, which are
+    // recycled once their value has been used for the last time
+    std::vector<uint16_t> reg(count, 0);
+    std::vector<double> constants;
+    for (size_t i = 0; i < count; ++i) {
+        if (nodes[i].kind == Kind::CONSTANT && needed[i]) {
+            reg[i] = static_cast<uint16_t>(1 + constants.size());
+            constants.push_back(nodes[i].value);
+        }
+    }
+    const uint16_t base = static_cast<uint16_t>(1 + constants.size());
+    size_t temporaries = 0;
+    std::vector<uint16_t> freeList;
+    auto release = [&](uint32_t node, size_t i) {
+        if (nodes[node].kind == Kind::OPERATION && lastUse[node] == i) {
+            freeList.push_back(reg[node]);
+        }
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto& node = nodes[i];
+        if (node.kind != Kind::OPERATION || !needed[i]) {
+            continue;
+        }
+        // Operands die first so the result may overwrite one of them; the
+        // kernels work lane by lane, so that is safe
+        release(node.a, i);
+        if (node.b != node.a) {
+            release(node.b, i);
+        }
+        uint16_t dst;
+        if (!freeList.empty()) {
+            dst = freeList.back();
+            freeList.pop_back();
+        } else if (temporaries < MAX_REGISTERS) {
+            dst = static_cast<uint16_t>(base + temporaries++);
+        } else {
+            operations.clear();
+            results.assign(programs.size(), NOT_COMPILED);
+            compiled = false;
+            return false;
+        }
+        reg[i] = dst;
+        operations.push_back({node.op, dst, reg[node.a], reg[node.b], node.programs});
+        if (lastUse[i] == 0) {
+            // Kept only for its errors
+            freeList.push_back(dst);
+        }
+    }
+
+    for (size_t k = 0; k < programs.size(); ++k) {
+        if (built[k]) {
+            results[k] = reg[resultNodes[k]];
+        }
+    }
+    registerCount = base + temporaries;
+
+    // One extra block per program at the end collects per-lane error flags
+    registers.assign((registerCount + programs.size()) * BLOCK, 0.0);
+    for (size_t c = 0; c < constants.size(); ++c) {
+        std::fill_n(lanes(static_cast<uint16_t>(1 + c)), BLOCK, constants[c]);
+    }
+    return true;
+}
+
+bool BatchEvaluator::isCompiled(size_t program) const {
+    return program < results.size() && results[program] != NOT_COMPILED;
+}
+
+void BatchEvaluator::evaluate(const double* x, double* y, size_t count) {
+    evaluate(x, &y, count);
+}
+
+void BatchEvaluator::evaluate(const double* x, double* const* y, size_t count) {
+    double* xLanes = lanes(0);
+    double* errors = lanes(static_cast<uint16_t>(registerCount));
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    for (size_t start = 0; start < count; start += BLOCK) {
+        size_t n = std::min(BLOCK, count - start);
+        std::copy_n(x + start, n, xLanes);
+        // Pad a short final block with a real sample so the padding stays
+        // on the fast paths
+        std::fill(xLanes + n, xLanes + BLOCK, x[start + n - 1]);
+        std::fill_n(errors, results.size() * BLOCK, 0.0);
+
+        runBlock(errors);
+
+        for (size_t k = 0; k < results.size(); ++k) {
+            if (results[k] == NOT_COMPILED) {
+                continue;
+            }
+            const double* values = lanes(results[k]);
+            const double* failedLanes = errors + k * BLOCK;
+            double* out = y[k] + start;
+            for (size_t i = 0; i < n; ++i) {
+                uint64_t failed;
+                std::memcpy(&failed, failedLanes + i, sizeof(failed));
+                out[i] = failed ? nan : values[i];
+            }
+        }
+    }
+}
+
+void BatchEvaluator::runBlock(double* errors) {
+    const Vec zero = Vec::broadcast(0.0);
+
+    for (const Operation& operation : operations) {
+        const double* a = lanes(operation.a);
+        const double* b = lanes(operation.b);
+        double* dst = lanes(operation.dst);
+
+        switch (operation.op) {
+            case Builtin::Add: binaryLanes(a, b, dst, [](Vec p, Vec q) { return p + q; }); break;
+            case Builtin::Subtract: binaryLanes(a, b, dst, [](Vec p, Vec q) { return p - q; }); break;
+            case Builtin::Multiply: binaryLanes(a, b, dst, [](Vec p, Vec q) { return p * q; }); break;
+            case Builtin::Divide:
+                for (size_t i = 0; i < BLOCK; i += Vec::WIDTH) {
+                    Vec q = Vec::load(b + i);
+                    flag(errors, operation.programs, i, Simd::equal(q, zero));
+                    (Vec::load(a + i) / q).store(dst + i);
+                }
+                break;
+            case Builtin::Power:
+                scalarLanes(a, b, dst, [](double p, double q) { return std::pow(p, q); });
+                break;
+            case Builtin::Sin: unaryLanes(a, dst, [](Vec p) { return Simd::sin(p); }); break;
+            case Builtin::Cos: unaryLanes(a, dst, [](Vec p) { return Simd::cos(p); }); break;
+            case Builtin::Tan: unaryLanes(a, dst, [](Vec p) { return Simd::tan(p); }); break;
+            case Builtin::Sqrt:
+                for (size_t i = 0; i < BLOCK; i += Vec::WIDTH) {
+                    Vec p = Vec::load(a + i);
+                    flag(errors, operation.programs, i, Simd::lessThan(p, zero));
+                    Simd::sqrt(p).store(dst + i);
+                }
+                break;
+            case Builtin::Reciprocal:
+                for (size_t i = 0; i < BLOCK; i += Vec::WIDTH) {
+                    Vec p = Vec::load(a + i);
+                    flag(errors, operation.programs, i, Simd::equal(p, zero));
+                    (Vec::broadcast(1.0) / p).store(dst + i);
+                }
+                break;
+            case Builtin::Negate: unaryLanes(a, dst, [](Vec p) { return p ^ Vec::broadcast(-0.0); }); break;
+            case Builtin::Ln:
+            case Builtin::Log: {
+                bool base10 = operation.op == Builtin::Log;
+                for (size_t i = 0; i < BLOCK; i += Vec::WIDTH) {
+                    Vec p = Vec::load(a + i);
+                    Vec failed = Simd::lessEqual(p, zero);
+                    flag(errors, operation.programs, i, failed);
+                    // Failed lanes are discarded; keep them off the slow path
+                    p = Simd::select(failed, Vec::broadcast(1.0), p);
+                    (base10 ? Simd::log10(p) : Simd::log(p)).store(dst + i);
+                }
+                break;
+            }
+            case Builtin::Exp: unaryLanes(a, dst, [](Vec p) { return Simd::exp(p); }); break;
+            case Builtin::Greater:
+                binaryLanes(a, b, dst, [](Vec p, Vec q) { return boolean(Simd::lessThan(q, p)); });
+                break;
+            case Builtin::Less:
+                binaryLanes(a, b, dst, [](Vec p, Vec q) { return boolean(Simd::lessThan(p, q)); });
+                break;
+            case Builtin::GreaterEqual:
+                binaryLanes(a, b, dst, [](Vec p, Vec q) { return boolean(Simd::lessEqual(q, p)); });
+                break;
+            case Builtin::LessEqual:
+                binaryLanes(a, b, dst, [](Vec p, Vec q) { return boolean(Simd::lessEqual(p, q)); });
+                break;
+            case Builtin::Equal:
+                binaryLanes(a, b, dst, [](Vec p, Vec q) {
+                    return boolean(Simd::lessThan(Simd::abs(p - q), Vec::broadcast(1e-10)));
+                });
+                break;
+            case Builtin::NotEqual:
+                binaryLanes(a, b, dst, [](Vec p, Vec q) {
+                    return boolean(Simd::lessEqual(Vec::broadcast(1e-10), Simd::abs(p - q)));
+                });
+                break;
+            case Builtin::Abs: unaryLanes(a, dst, [](Vec p) { return Simd::abs(p); }); break;
+            case Builtin::Mod:
+                for (size_t i = 0; i < BLOCK; i += Vec::WIDTH) {
+                    flag(errors, operation.programs, i, Simd::equal(Vec::load(b + i), zero));
+                }
+                scalarLanes(a, b, dst, [](double p, double q) { return std::fmod(p, q); });
+                break;
+            case Builtin::Round:
+                scalarLanes(a, b, dst, [](double p, double) { return std::round(p); });
+                break;
+            case Builtin::Floor:
+                scalarLanes(a, b, dst, [](double p, double) { return std::floor(p); });
+                break;
+            case Builtin::Ceil:
+                scalarLanes(a, b, dst, [](double p, double) { return std::ceil(p); });
+                break;
+            case Builtin::Min: binaryLanes(a, b, dst, [](Vec p, Vec q) { return Simd::min(p, q); }); break;
+            case Builtin::Max: binaryLanes(a, b, dst, [](Vec p, Vec q) { return Simd::max(p, q); }); break;
+            default:
+                // Stack operations never reach the register program
+                break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef BATCH_EVALUATOR_H
+#define BATCH_EVALUATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Builtins.h"
+#include "FunctionTable.h"
+#include "Program.h"
+
+namespace RPN {
+
+// Evaluates a compiled expression for many x values at once. compile()
+// inlines calls and resolves stack shuffles into operations on numbered
+// registers, each holding one value per lane of a block, so evaluation is
+// a single pass per operation using the SIMD kernels in SimdMath.h.
+//
+// Several programs can be compiled together over the same x: identical
+// operations on identical operands are emitted once, within a program or
+// across programs, so curves that share subexpressions share their cost.
+//
+// Results match EvaluationContext::evaluate lane for lane, except for the
+// documented ulp error of the vector transcendentals; lanes where the
+// interpreter would fail (division by zero, sqrt or log out of domain)
+// come out as NaN, for the programs that run the failing operation only.
+// Programs whose stack effect depends on the data, such as pick or roll
+// with a computed index or recursive calls, are rejected and callers fall
+// back to the interpreter.
+class BatchEvaluator {
+public:
+    // Lanes per block: each operation runs over this many x values.
+    static constexpr size_t BLOCK = 64;
+    static constexpr size_t MAX_REGISTERS = 256;
+    static constexpr size_t MAX_OPERATIONS = 4096;
+    static constexpr size_t MAX_PROGRAMS = 64;
+
+    bool compile(const Program& program, const FunctionTable& functions, size_t stackCapacity);
+    // Compiles each program that can be; false if none could. A program
+    // that is rejected leaves the others compiled.
+    bool compile(const std::vector<const Program*>& programs, const FunctionTable& functions,
+                 size_t stackCapacity);
+    bool isCompiled() const { return compiled; }
+    bool isCompiled(size_t program) const;
+    // Operations run per block, after sharing
+    size_t operationCount() const { return operations.size(); }
+
+    // Writes the program's result for x[i] to y[i]. Requires isCompiled().
+    void evaluate(const double* x, double* y, size_t count);
+    // Writes program k's result for x[i] to y[k][i], for each compiled k;
+    // the arrays of rejected programs are left alone.
+    void evaluate(const double* x, double* const* y, size_t count);
+
+    // "AVX2", "SSE2" or "scalar", depending on how the library was built.
+    static const char* instructionSet();
+
+private:
+    static constexpr uint16_t NOT_COMPILED = 0xFFFF;
+
+    struct Operation {
+        Builtin op;
+        uint16_t dst;
+        uint16_t a;
+        uint16_t b;
+        // Bit k set if program k runs this operation, for error flags
+        uint64_t programs;
+    };
+
+    // Register 0 holds x, then the constants, then temporaries
+    std::vector<Operation> operations;
+    std::vector<double> registers;
+    size_t registerCount = 0;
+    // Result register per program
+    std::vector<uint16_t> results;
+    bool compiled = false;
+
+    double* lanes(uint16_t reg) { return registers.data() + reg * BLOCK; }
+    void runBlock(double* errors);
+};
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "Builtins.h"
+#include <unordered_map>
+
+namespace RPN {
+
+namespace {
+
+struct BuiltinInfo {
+    const char* name;
+    Arity arity;
+};
+
+constexpr BuiltinInfo builtinTable[] = {
+    {"+", Arity::BINARY},
+    {"-", Arity::BINARY},
+    {"*", Arity::BINARY},
+    {"/", Arity::BINARY},
+    {"^", Arity::BINARY},
+    {"sin", Arity::UNARY},
+    {"cos", Arity::UNARY},
+    {"tan", Arity::UNARY},
+    {"sqrt", Arity::UNARY},
+    {"1/x", Arity::UNARY},
+    {"+/-", Arity::UNARY},
+    {"ln", Arity::UNARY},
+    {"log", Arity::UNARY},
+    {"exp", Arity::UNARY},
+    {">", Arity::BINARY},
+    {"<", Arity::BINARY},
+    {">=", Arity::BINARY},
+    {"<=", Arity::BINARY},
+    {"==", Arity::BINARY},
+    {"!=", Arity::BINARY},
+    {"abs", Arity::UNARY},
+    {"mod", Arity::BINARY},
+    {"round", Arity::UNARY},
+    {"floor", Arity::UNARY},
+    {"ceil", Arity::UNARY},
+    {"min", Arity::BINARY},
+    {"max", Arity::BINARY},
+    {"dup", Arity::STACK},
+    {"drop", Arity::STACK},
+    {"swap", Arity::STACK},
+    {"rot", Arity::STACK},
+    {"over", Arity::STACK},
+    {"pick", Arity::STACK},
+    {"roll", Arity::STACK},
+};
+
+static_assert(sizeof(builtinTable) / sizeof(builtinTable[0]) == static_cast<size_t>(Builtin::Count),
+              "builtinTable must have one entry per Builtin");
+
+}
+
+const char* builtinName(Builtin op) {
+    return builtinTable[static_cast<size_t>(op)].name;
+}
+
+Arity builtinArity(Builtin op) {
+    return builtinTable[static_cast<size_t>(op)].arity;
+}
+
+bool findBuiltin(std::string_view name, Builtin& op) {
+    static const std::unordered_map<std::string_view, Builtin> index = [] {
+        std::unordered_map<std::string_view, Builtin> map;
+        for (size_t i = 0; i < static_cast<size_t>(Builtin::Count); ++i) {
+            map.emplace(builtinTable[i].name, static_cast<Builtin>(i));
+        }
+        return map;
+    }();
+
+    auto it = index.find(name);
+    if (it == index.end()) {
+        return false;
+    }
+    op = it->second;
+    return true;
+}
+
+}
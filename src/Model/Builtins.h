@@ -0,0 +1,98 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <algorithm>
+
+namespace RPN {
+
+// Dense opcode for every built-in operation. The order matches the
+// name table in Builtins.cpp; Count must stay last.
+enum class Builtin : uint8_t {
+    Add, Subtract, Multiply, Divide, Power,
+    Sin, Cos, Tan,
+    Sqrt, Reciprocal, Negate, Ln, Log, Exp,
+    Greater, Less, GreaterEqual, LessEqual, Equal, NotEqual,
+    Abs, Mod, Round, Floor, Ceil, Min, Max,
+    Dup, Drop, Swap, Rot, Over, Pick, Roll,
+    Count
+};
+
+enum class Arity : uint8_t {
+    UNARY,
+    BINARY,
+    STACK
+};
+
+const char* builtinName(Builtin op);
+Arity builtinArity(Builtin op);
+
+// Name lookup for the interactive path; compiled code never calls this.
+bool findBuiltin(std::string_view name, Builtin& op);
+
+// Pure arithmetic for unary and binary builtins. Returns nullptr on
+// success, otherwise a static error message and result is untouched.
+inline const char* applyUnary(Builtin op, double a, double& result) {
+    switch (op) {
+        case Builtin::Sin: result = std::sin(a); break;
+        case Builtin::Cos: result = std::cos(a); break;
+        case Builtin::Tan: result = std::tan(a); break;
+        case Builtin::Sqrt:
+            if (a < 0) return "Square root of negative number";
+            result = std::sqrt(a);
+            break;
+        case Builtin::Reciprocal:
+            if (a == 0) return "Division by zero";
+            result = 1.0 / a;
+            break;
+        case Builtin::Negate: result = -a; break;
+        case Builtin::Ln:
+            if (a <= 0) return "Logarithm of non-positive number";
+            result = std::log(a);
+            break;
+        case Builtin::Log:
+            if (a <= 0) return "Logarithm of non-positive number";
+            result = std::log10(a);
+            break;
+        case Builtin::Exp: result = std::exp(a); break;
+        case Builtin::Abs: result = std::abs(a); break;
+        case Builtin::Round: result = std::round(a); break;
+        case Builtin::Floor: result = std::floor(a); break;
+        case Builtin::Ceil: result = std::ceil(a); break;
+        default: return "Not a unary operation";
+    }
+    return nullptr;
+}
+
+inline const char* applyBinary(Builtin op, double a, double b, double& result) {
+    switch (op) {
+        case Builtin::Add: result = a + b; break;
+        case Builtin::Subtract: result = a - b; break;
+        case Builtin::Multiply: result = a * b; break;
+        case Builtin::Divide:
+            if (b == 0) return "Division by zero";
+            result = a / b;
+            break;
+        case Builtin::Power: result = std::pow(a, b); break;
+        case Builtin::Greater: result = (a > b) ? 1.0 : 0.0; break;
+        case Builtin::Less: result = (a < b) ? 1.0 : 0.0; break;
+        case Builtin::GreaterEqual: result = (a >= b) ? 1.0 : 0.0; break;
+        case Builtin::LessEqual: result = (a <= b) ? 1.0 : 0.0; break;
+        case Builtin::Equal: result = (std::abs(a - b) < 1e-10) ? 1.0 : 0.0; break;
+        case Builtin::NotEqual: result = (std::abs(a - b) >= 1e-10) ? 1.0 : 0.0; break;
+        case Builtin::Mod:
+            if (b == 0) return "Division by zero";
+            result = std::fmod(a, b);
+            break;
+        case Builtin::Min: result = std::min(a, b); break;
+        case Builtin::Max: result = std::max(a, b); break;
+        default: return "Not a binary operation";
+    }
+    return nullptr;
+}
+
+}
+
+#endif
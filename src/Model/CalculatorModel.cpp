@@ -1,161 +1,28 @@
 #include "CalculatorModel.h"
+#include "NumberLexer.h"
+#include "ProgramOptimizer.h"
 #include <cmath>
 #include <sstream>
-#include <stdexcept>
 #include <algorithm>
+#include <charconv>
 
-CalculatorModel::CalculatorModel() {
-    registerOperations();
-}
-
-void CalculatorModel::registerOperations() {
-    // Basic arithmetic
-    operations.emplace("+", Operation("+", OperationType::BINARY, 
-        [](double a, double b) { return a + b; }));
-    
-    operations.emplace("-", Operation("-", OperationType::BINARY, 
-        [](double a, double b) { return a - b; }));
-    
-    operations.emplace("*", Operation("*", OperationType::BINARY, 
-        [](double a, double b) { return a * b; }));
-    
-    operations.emplace("/", Operation("/", OperationType::BINARY, 
-        [this](double a, double b) { 
-            if (b == 0) {
-                setError("Division by zero");
-                return 0.0;
-            }
-            return a / b; 
-        }));
-    
-    operations.emplace("^", Operation("^", OperationType::BINARY, 
-        [](double a, double b) { return std::pow(a, b); }));
-    
-    // Trigonometric functions
-    operations.emplace("sin", Operation("sin", OperationType::UNARY, 
-        [](double a, double) { return std::sin(a); }));
-    
-    operations.emplace("cos", Operation("cos", OperationType::UNARY, 
-        [](double a, double) { return std::cos(a); }));
-    
-    operations.emplace("tan", Operation("tan", OperationType::UNARY, 
-        [](double a, double) { return std::tan(a); }));
-    
-    // Math functions
-    operations.emplace("sqrt", Operation("sqrt", OperationType::UNARY, 
-        [this](double a, double) { 
-            if (a < 0) {
-                setError("Square root of negative number");
-                return 0.0;
-            }
-            return std::sqrt(a); 
-        }));
-    
-    operations.emplace("1/x", Operation("1/x", OperationType::UNARY, 
-        [this](double a, double) { 
-            if (a == 0) {
-                setError("Division by zero");
-                return 0.0;
-            }
-            return 1.0 / a; 
-        }));
-    
-    operations.emplace("+/-", Operation("+/-", OperationType::UNARY, 
-        [](double a, double) { return -a; }));
-    
-    operations.emplace("ln", Operation("ln", OperationType::UNARY, 
-        [this](double a, double) { 
-            if (a <= 0) {
-                setError("Logarithm of non-positive number");
-                return 0.0;
-            }
-            return std::log(a); 
-        }));
-    
-    operations.emplace("log", Operation("log", OperationType::UNARY, 
-        [this](double a, double) { 
-            if (a <= 0) {
-                setError("Logarithm of non-positive number");
-                return 0.0;
-            }
-            return std::log10(a); 
-        }));
-    
-    operations.emplace("exp", Operation("exp", OperationType::UNARY, 
-        [](double a, double) { return std::exp(a); }));
-    
-    operations.emplace("dup", Operation("dup", OperationType::UNARY, 
-        [this](double a, double) { 
-            pushValue(a);
-            return a; 
-        }));
-    
-    // Comparison operations
-    operations.emplace(">", Operation(">", OperationType::BINARY, 
-        [](double a, double b) { return (a > b) ? 1.0 : 0.0; }));
-    
-    operations.emplace("<", Operation("<", OperationType::BINARY, 
-        [](double a, double b) { return (a < b) ? 1.0 : 0.0; }));
-    
-    operations.emplace(">=", Operation(">=", OperationType::BINARY, 
-        [](double a, double b) { return (a >= b) ? 1.0 : 0.0; }));
-    
-    operations.emplace("<=", Operation("<=", OperationType::BINARY, 
-        [](double a, double b) { return (a <= b) ? 1.0 : 0.0; }));
-    
-    operations.emplace("==", Operation("==", OperationType::BINARY, 
-        [](double a, double b) { return (std::abs(a - b) < 1e-10) ? 1.0 : 0.0; }));
-    
-    operations.emplace("!=", Operation("!=", OperationType::BINARY, 
-        [](double a, double b) { return (std::abs(a - b) >= 1e-10) ? 1.0 : 0.0; }));
-    
-    // More stack operations
-    operations.emplace("abs", Operation("abs", OperationType::UNARY, 
-        [](double a, double) { return std::abs(a); }));
-    
-    operations.emplace("mod", Operation("mod", OperationType::BINARY, 
-        [this](double a, double b) { 
-            if (b == 0) {
-                setError("Division by zero");
-                return 0.0;
-            }
-            return std::fmod(a, b); 
-        }));
-    
-    operations.emplace("round", Operation("round", OperationType::UNARY, 
-        [](double a, double) { return std::round(a); }));
-    
-    operations.emplace("floor", Operation("floor", OperationType::UNARY, 
-        [](double a, double) { return std::floor(a); }));
-    
-    operations.emplace("ceil", Operation("ceil", OperationType::UNARY, 
-        [](double a, double) { return std::ceil(a); }));
-    
-    operations.emplace("min", Operation("min", OperationType::BINARY, 
-        [](double a, double b) { return std::min(a, b); }));
-    
-    operations.emplace("max", Operation("max", OperationType::BINARY, 
-        [](double a, double b) { return std::max(a, b); }));
+CalculatorModel::CalculatorModel(size_t stackCapacity, size_t historyCapacity)
+    : functionTable(std::make_shared<RPN::FunctionTable>()),
+      history(historyCapacity),
+      context(functionTable, stackCapacity) {
+    context.setHistory(&history);
 }
 
 void CalculatorModel::pushValue(double value) {
-    stack.push_back(value);
-    if (stack.size() > 100) {
-        stack.erase(stack.begin());
-    }
+    context.pushValue(value);
 }
 
 bool CalculatorModel::popValue(double& value) {
-    if (stack.empty()) {
-        setError("Stack underflow");
-        return false;
-    }
-    value = stack.back();
-    stack.pop_back();
-    return true;
+    return context.popValue(value);
 }
 
 void CalculatorModel::drop() {
+    auto& stack = context.getStack();
     if (!stack.empty()) {
         stack.pop_back();
     } else {
@@ -164,6 +31,7 @@ void CalculatorModel::drop() {
 }
 
 void CalculatorModel::swap() {
+    auto& stack = context.getStack();
     if (stack.size() >= 2) {
         std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
     } else {
@@ -172,11 +40,11 @@ void CalculatorModel::swap() {
 }
 
 void CalculatorModel::clear() {
-    stack.clear();
-    clearError();
+    context.clear();
 }
 
 void CalculatorModel::duplicate() {
+    const auto& stack = context.getStack();
     if (!stack.empty()) {
         pushValue(stack.back());
     } else {
@@ -185,72 +53,8 @@ void CalculatorModel::duplicate() {
 }
 
 bool CalculatorModel::executeOperation(const std::string& opName) {
-    // Special stack operations
-    if (opName == "rot") {
-        if (stack.size() >= 3) {
-            double c = stack.back(); stack.pop_back();
-            double b = stack.back(); stack.pop_back();
-            double a = stack.back(); stack.pop_back();
-            stack.push_back(b);
-            stack.push_back(c);
-            stack.push_back(a);
-            addToHistory(opName);
-            return true;
-        } else {
-            setError("Need at least 3 values on stack for rot");
-            return false;
-        }
-    } else if (opName == "over") {
-        if (stack.size() >= 2) {
-            double b = stack.back(); stack.pop_back();
-            double a = stack.back();
-            stack.push_back(b);
-            stack.push_back(a);
-            addToHistory(opName);
-            return true;
-        } else {
-            setError("Need at least 2 values on stack for over");
-            return false;
-        }
-    } else if (opName == "pick") {
-        if (!stack.empty()) {
-            double n = stack.back(); stack.pop_back();
-            int index = static_cast<int>(n);
-            if (index >= 0 && index < stack.size()) {
-                double value = stack[stack.size() - 1 - index];
-                stack.push_back(value);
-                addToHistory(opName);
-                return true;
-            } else {
-                stack.push_back(n);
-                setError("Invalid index for pick");
-                return false;
-            }
-        } else {
-            setError("Stack is empty");
-            return false;
-        }
-    } else if (opName == "roll") {
-        if (!stack.empty()) {
-            double n = stack.back(); stack.pop_back();
-            int count = static_cast<int>(n);
-            if (count > 0 && count <= stack.size()) {
-                std::rotate(stack.end() - count, stack.end() - 1, stack.end());
-                addToHistory(opName);
-                return true;
-            } else {
-                stack.push_back(n);
-                setError("Invalid count for roll");
-                return false;
-            }
-        } else {
-            setError("Stack is empty");
-            return false;
-        }
-    }
-    
-    auto it = operations.find(opName);
-    if (it == operations.end()) {
+    RPN::Builtin op;
+    if (!RPN::findBuiltin(opName, op)) {
         if (isFunctionDefined(opName)) {
             return executeFunction(opName);
         }
@@ -258,42 +62,7 @@ bool CalculatorModel::executeOperation(const std::string& opName) {
         return false;
     }
     
-    const Operation& op = it->second;
-    clearError();
-    
-    if (op.type == OperationType::UNARY) {
-        if (stack.size() < 1) {
-            setError("Need at least 1 value on stack");
-            return false;
-        }
-        double a;
-        popValue(a);
-        double result = op.func(a, 0);
-        if (!hasError()) {
-            pushValue(result);
-            addToHistory(opName);
-            return true;
-        }
-        pushValue(a);
-        return false;
-    } else {
-        if (stack.size() < 2) {
-            setError("Need at least 2 values on stack");
-            return false;
-        }
-        double b, a;
-        popValue(b);
-        popValue(a);
-        double result = op.func(a, b);
-        if (!hasError()) {
-            pushValue(result);
-            addToHistory(opName);
-            return true;
-        }
-        pushValue(a);
-        pushValue(b);
-        return false;
-    }
+    return context.executeBuiltin(op);
 }
 
 void CalculatorModel::setInputBuffer(const std::string& buffer) {
@@ -316,90 +85,208 @@ void CalculatorModel::clearInput() {
 
 bool CalculatorModel::enterInput() {
     if (!inputBuffer.empty()) {
-        if (inputBuffer.find('{') != std::string::npos && inputBuffer.find('}') != std::string::npos) {
-            bool result = parseFunctionDefinition(inputBuffer);
+        ScriptResult result = executeScript(inputBuffer);
+        if (result.success) {
             inputBuffer.clear();
-            return result;
+            return true;
+        }
+        // Tokens before the failing one have been applied; keep only the
+        // rest, so entering the line again does not repeat them
+        inputBuffer.erase(0, result.errorOffset);
+        return false;
+    } else if (!context.getStack().empty()) {
+        duplicate();
+        return true;
+    }
+    return false;
+}
+
+namespace {
+
+bool isScriptSpace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+// Returns the next token starting at or after pos, or an empty view at the
+// end of the script. Braces are always single-character tokens.
+std::string_view nextScriptToken(std::string_view script, size_t& pos) {
+    while (pos < script.size() && isScriptSpace(script[pos])) {
+        ++pos;
+    }
+    size_t start = pos;
+    if (pos < script.size() && (script[pos] == '{' || script[pos] == '}')) {
+        ++pos;
+    } else {
+        while (pos < script.size() && !isScriptSpace(script[pos]) &&
+               script[pos] != '{' && script[pos] != '}') {
+            ++pos;
+        }
+    }
+    return script.substr(start, pos - start);
+}
+
+}
+
+CalculatorModel::ScriptResult CalculatorModel::executeScript(std::string_view script) {
+    ScriptResult result;
+    clearError();
+    
+    auto fail = [&](std::string_view token) {
+        result.success = false;
+        result.errorOffset = static_cast<size_t>(token.data() - script.data());
+        result.errorToken = token;
+        return result;
+    };
+    
+    size_t pos = 0;
+    for (std::string_view token = nextScriptToken(script, pos); !token.empty();
+         token = nextScriptToken(script, pos)) {
+        if (token == "{") {
+            setError("Function name cannot be empty");
+            return fail(token);
+        }
+        if (token == "}") {
+            setError("Invalid function definition syntax. Use: functionName { body }");
+            return fail(token);
         }
         
-        try {
-            double value = std::stod(inputBuffer);
-            pushValue(value);
-            addToHistory(inputBuffer);
-            inputBuffer.clear();
-            return true;
-        } catch (const std::exception&) {
-            if (executeOperation(inputBuffer)) {
-                inputBuffer.clear();
-                return true;
+        // A word followed by '{' names an inline definition.
+        size_t peek = pos;
+        if (nextScriptToken(script, peek) == "{") {
+            std::vector<std::string> body;
+            std::string_view bodyToken = nextScriptToken(script, peek);
+            while (!bodyToken.empty() && bodyToken != "}" && bodyToken != "{") {
+                body.emplace_back(bodyToken);
+                bodyToken = nextScriptToken(script, peek);
             }
-            setError("Invalid input: " + inputBuffer);
-            return false;
+            if (bodyToken != "}") {
+                setError("Invalid function definition syntax. Use: functionName { body }");
+                return fail(token);
+            }
+            if (!defineFunction(std::string(token), body)) {
+                return fail(token);
+            }
+            pos = peek;
+            ++result.tokensExecuted;
+            ++result.functionsDefined;
+            continue;
         }
-    } else if (!stack.empty()) {
-        duplicate();
+        
+        if (!executeToken(token)) {
+            return fail(token);
+        }
+        ++result.tokensExecuted;
+    }
+    
+    return result;
+}
+
+bool CalculatorModel::executeToken(std::string_view token) {
+    double value;
+    if (RPN::parseNumber(token, value)) {
+        pushValue(value);
+        addToHistory(HistoryEntry::Kind::LITERAL, 0, value);
         return true;
     }
+    
+    RPN::Builtin op;
+    if (RPN::findBuiltin(token, op)) {
+        return context.executeBuiltin(op);
+    }
+    
+    uint32_t slot;
+    if (functionTable->find(token, slot)) {
+        return context.callFunction(slot);
+    }
+    
+    setError("Invalid input: " + std::string(token));
     return false;
 }
 
-void CalculatorModel::addToHistory(const std::string& entry) {
-    history.push_back(entry);
-    if (history.size() > 50) {
-        history.erase(history.begin());
+void CalculatorModel::addToHistory(HistoryEntry::Kind kind, uint32_t id, double value) {
+    history.push_back({kind, id, value});
+}
+
+std::string CalculatorModel::formatHistoryEntry(const HistoryEntry& entry) const {
+    switch (entry.kind) {
+        case HistoryEntry::Kind::LITERAL: {
+            char buffer[32];
+            auto result = std::to_chars(buffer, buffer + sizeof(buffer), entry.value);
+            return std::string(buffer, result.ptr);
+        }
+        case HistoryEntry::Kind::BUILTIN:
+            return RPN::builtinName(static_cast<RPN::Builtin>(entry.id));
+        case HistoryEntry::Kind::FUNCTION:
+            return functionTable->at(entry.id).name;
+        case HistoryEntry::Kind::DEFINITION:
+            return "def " + functionTable->at(entry.id).name;
     }
+    return std::string();
 }
 
 void CalculatorModel::setError(const std::string& error) {
-    errorMessage = error;
+    context.setError(error);
 }
 
 bool CalculatorModel::defineFunction(const std::string& name, const std::vector<std::string>& body) {
-    if (operations.find(name) != operations.end()) {
+    RPN::Builtin op;
+    if (RPN::findBuiltin(name, op)) {
         setError("Cannot redefine built-in operation: " + name);
         return false;
     }
     
-    functions[name] = Function(name, body);
-    addToHistory("def " + name);
+    RPN::Program code = RPN::optimizeProgram(compileFunctionBody(body));
+    uint32_t slot = functionTable->declare(name);
+    functionTable->define(slot, body, std::move(code));
+    functionSnapshot.reset();
+    addToHistory(HistoryEntry::Kind::DEFINITION, slot);
     return true;
 }
 
-bool CalculatorModel::executeFunction(const std::string& name) {
-    auto it = functions.find(name);
-    if (it == functions.end()) {
-        return false;
+RPN::Program CalculatorModel::compileFunctionBody(const std::vector<std::string>& body) {
+    RPN::Program code;
+    code.reserve(body.size());
+    
+    for (const std::string& token : body) {
+        double value;
+        RPN::Builtin op;
+        if (RPN::parseNumber(token, value)) {
+            code.push_back({OpCode::PUSH, 0, value});
+        } else if (RPN::findBuiltin(token, op)) {
+            code.push_back({OpCode::BUILTIN, static_cast<uint32_t>(op), 0.0});
+        } else {
+            // Late binding: unknown names get a slot now and are checked when called,
+            // so forward references, recursion and redefinition all work.
+            code.push_back({OpCode::CALL, functionTable->declare(token), 0.0});
+        }
     }
     
-    const Function& func = it->second;
-    clearError();
-    
-    for (const std::string& token : func.body) {
-        try {
-            double value = std::stod(token);
-            pushValue(value);
-        } catch (const std::exception&) {
-            if (operations.find(token) != operations.end()) {
-                if (!executeOperation(token)) {
-                    return false;
-                }
-            } else if (functions.find(token) != functions.end()) {
-                if (!executeFunction(token)) {
-                    return false;
-                }
-            } else {
-                setError("Unknown token in function: " + token);
-                return false;
-            }
-        }
+    return code;
+}
+
+bool CalculatorModel::executeFunction(const std::string& name) {
+    uint32_t slot;
+    if (!functionTable->find(name, slot)) {
+        return false;
     }
     
-    addToHistory(name);
-    return true;
+    return context.callFunction(slot);
 }
 
 bool CalculatorModel::isFunctionDefined(const std::string& name) const {
-    return functions.find(name) != functions.end();
+    uint32_t slot;
+    return functionTable->find(name, slot);
+}
+
+bool CalculatorModel::findFunction(std::string_view name, uint32_t& slot) const {
+    return functionTable->find(name, slot);
+}
+
+std::shared_ptr<const RPN::FunctionTable> CalculatorModel::snapshotFunctions() const {
+    if (!functionSnapshot) {
+        functionSnapshot = std::make_shared<const RPN::FunctionTable>(*functionTable);
+    }
+    return functionSnapshot;
 }
 
 bool CalculatorModel::parseFunctionDefinition(const std::string& input) {
@@ -3,37 +3,42 @@
 
 #include <vector>
 #include <string>
-#include <functional>
-#include <unordered_map>
-#include <queue>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include "Builtins.h"
+#include "EvaluationContext.h"
+#include "FunctionTable.h"
+#include "Program.h"
+#include "RingBuffer.h"
 
 class CalculatorModel {
 public:
-    enum class OperationType {
-        UNARY,
-        BINARY,
-        SPECIAL
-    };
+    // Function bodies are compiled once at definition time; see Program.h.
+    using OpCode = RPN::OpCode;
+    using Instruction = RPN::Instruction;
+    using HistoryEntry = RPN::HistoryEntry;
+    using Function = RPN::Function;
 
-    struct Operation {
-        std::string name;
-        OperationType type;
-        std::function<double(double, double)> func;
-        
-        Operation(const std::string& n, OperationType t, std::function<double(double, double)> f)
-            : name(n), type(t), func(f) {}
+    // Outcome of executeScript. On failure errorOffset/errorToken locate the
+    // token that failed (errorToken views the caller's script text) and
+    // getError() holds the message; tokens before it remain applied.
+    // Inline definitions count as one token each and leave the stack alone.
+    struct ScriptResult {
+        bool success = true;
+        size_t errorOffset = std::string_view::npos;
+        std::string_view errorToken;
+        size_t tokensExecuted = 0;
+        size_t functionsDefined = 0;
     };
 
-    struct Function {
-        std::string name;
-        std::vector<std::string> body;
-        
-        Function() = default;
-        Function(const std::string& n, const std::vector<std::string>& b)
-            : name(n), body(b) {}
-    };
+    static constexpr size_t DEFAULT_STACK_CAPACITY = RPN::EvaluationContext::DEFAULT_STACK_CAPACITY;
+    static constexpr size_t DEFAULT_HISTORY_CAPACITY = 50;
 
-    CalculatorModel();
+    explicit CalculatorModel(size_t stackCapacity = DEFAULT_STACK_CAPACITY,
+                             size_t historyCapacity = DEFAULT_HISTORY_CAPACITY);
+    CalculatorModel(const CalculatorModel&) = delete;
+    CalculatorModel& operator=(const CalculatorModel&) = delete;
 
     void pushValue(double value);
     bool popValue(double& value);
@@ -47,34 +52,51 @@ public:
     bool defineFunction(const std::string& name, const std::vector<std::string>& body);
     bool executeFunction(const std::string& name);
     bool isFunctionDefined(const std::string& name) const;
+    bool findFunction(std::string_view name, uint32_t& slot) const;
     bool parseFunctionDefinition(const std::string& input);
     
+    // Runs a whole program such as "3 4 + 2 *" or "sq { dup * } 5 sq",
+    // lexing in place without allocating per token.
+    ScriptResult executeScript(std::string_view script);
+    
+    // Immutable copy of the current function table, cached until the next
+    // definition. Contexts built from it never touch the interactive stack.
+    std::shared_ptr<const RPN::FunctionTable> snapshotFunctions() const;
+    RPN::EvaluationContext createContext() const { return RPN::EvaluationContext(snapshotFunctions()); }
+    
     void setInputBuffer(const std::string& buffer);
     void appendToInput(const std::string& str);
     void backspace();
     void clearInput();
     bool enterInput();
     
-    const std::vector<double>& getStack() const { return stack; }
+    // Oldest value evicted when a push exceeds the capacity.
+    void setStackCapacity(size_t capacity) { context.getStack().setCapacity(capacity); }
+    size_t getStackCapacity() const { return context.getStack().capacity(); }
+    
+    const RPN::RingBuffer<double>& getStack() const { return context.getStack(); }
     const std::string& getInputBuffer() const { return inputBuffer; }
-    const std::vector<std::string>& getHistory() const { return history; }
-    const std::unordered_map<std::string, Function>& getFunctions() const { return functions; }
+    const RPN::RingBuffer<HistoryEntry>& getHistory() const { return history; }
+    std::string formatHistoryEntry(const HistoryEntry& entry) const;
+    void setHistoryCapacity(size_t capacity) { history.setCapacity(capacity); }
+    // Indexed by function slot; slots referenced before definition have defined == false.
+    const std::vector<Function>& getFunctions() const { return functionTable->all(); }
     
-    bool hasError() const { return !errorMessage.empty(); }
-    const std::string& getError() const { return errorMessage; }
-    void clearError() { errorMessage.clear(); }
+    bool hasError() const { return context.hasError(); }
+    const std::string& getError() const { return context.getError(); }
+    void clearError() { context.clearError(); }
 
 private:
-    std::vector<double> stack;
+    std::shared_ptr<RPN::FunctionTable> functionTable;
+    mutable std::shared_ptr<const RPN::FunctionTable> functionSnapshot;
+    RPN::RingBuffer<HistoryEntry> history;
+    RPN::EvaluationContext context;
     std::string inputBuffer;
-    std::vector<std::string> history;
-    std::string errorMessage;
-    std::unordered_map<std::string, Operation> operations;
-    std::unordered_map<std::string, Function> functions;
     
-    void registerOperations();
-    void addToHistory(const std::string& entry);
+    bool executeToken(std::string_view token);
+    RPN::Program compileFunctionBody(const std::vector<std::string>& body);
+    void addToHistory(HistoryEntry::Kind kind, uint32_t id, double value = 0.0);
     void setError(const std::string& error);
 };
 
-#endif
\ No newline at end of file
+#endif
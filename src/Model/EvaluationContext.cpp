@@ -0,0 +1,225 @@
+#include "EvaluationContext.h"
+#include <utility>
+
+namespace RPN {
+
+EvaluationContext::EvaluationContext(std::shared_ptr<const FunctionTable> functions, size_t stackCapacity)
+    : functions(std::move(functions)), stack(stackCapacity) {
+}
+
+bool EvaluationContext::popValue(double& value) {
+    if (stack.empty()) {
+        setError("Stack underflow");
+        return false;
+    }
+    value = stack.back();
+    stack.pop_back();
+    return true;
+}
+
+void EvaluationContext::clear() {
+    stack.clear();
+    clearError();
+}
+
+bool EvaluationContext::executeBuiltin(Builtin op) {
+    clearError();
+    
+    switch (builtinArity(op)) {
+        case Arity::UNARY: {
+            if (stack.size() < 1) {
+                setError("Need at least 1 value on stack");
+                return false;
+            }
+            double result;
+            if (const char* error = applyUnary(op, stack.back(), result)) {
+                setError(error);
+                return false;
+            }
+            stack.back() = result;
+            break;
+        }
+        case Arity::BINARY: {
+            if (stack.size() < 2) {
+                setError("Need at least 2 values on stack");
+                return false;
+            }
+            double b = stack[stack.size() - 1];
+            double a = stack[stack.size() - 2];
+            double result;
+            if (const char* error = applyBinary(op, a, b, result)) {
+                setError(error);
+                return false;
+            }
+            stack.pop_back();
+            stack.back() = result;
+            break;
+        }
+        case Arity::STACK:
+            if (!executeStackOperation(op)) {
+                return false;
+            }
+            break;
+    }
+    
+    record(HistoryEntry::Kind::BUILTIN, static_cast<uint32_t>(op));
+    return true;
+}
+
+bool EvaluationContext::executeStackOperation(Builtin op) {
+    switch (op) {
+        case Builtin::Dup:
+            if (stack.empty()) {
+                setError("Need at least 1 value on stack");
+                return false;
+            }
+            pushValue(stack.back());
+            return true;
+        case Builtin::Drop:
+            if (stack.empty()) {
+                setError("Stack is empty");
+                return false;
+            }
+            stack.pop_back();
+            return true;
+        case Builtin::Swap:
+            if (stack.size() < 2) {
+                setError("Need at least 2 values on stack");
+                return false;
+            }
+            std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+            return true;
+        case Builtin::Rot: {
+            if (stack.size() < 3) {
+                setError("Need at least 3 values on stack for rot");
+                return false;
+            }
+            size_t top = stack.size() - 1;
+            double a = stack[top - 2];
+            stack[top - 2] = stack[top - 1];
+            stack[top - 1] = stack[top];
+            stack[top] = a;
+            return true;
+        }
+        case Builtin::Over:
+            if (stack.size() < 2) {
+                setError("Need at least 2 values on stack for over");
+                return false;
+            }
+            pushValue(stack[stack.size() - 2]);
+            return true;
+        case Builtin::Pick: {
+            if (stack.empty()) {
+                setError("Stack is empty");
+                return false;
+            }
+            double n = stack.back();
+            int index = static_cast<int>(n);
+            if (index < 0 || static_cast<size_t>(index) >= stack.size() - 1) {
+                setError("Invalid index for pick");
+                return false;
+            }
+            stack.back() = stack[stack.size() - 2 - index];
+            return true;
+        }
+        case Builtin::Roll: {
+            if (stack.empty()) {
+                setError("Stack is empty");
+                return false;
+            }
+            double n = stack.back();
+            int count = static_cast<int>(n);
+            if (count <= 0 || static_cast<size_t>(count) > stack.size() - 1) {
+                setError("Invalid count for roll");
+                return false;
+            }
+            stack.pop_back();
+            size_t top = stack.size() - 1;
+            double moved = stack[top];
+            for (size_t i = top; i > top + 1 - count; --i) {
+                stack[i] = stack[i - 1];
+            }
+            stack[top + 1 - count] = moved;
+            return true;
+        }
+        default:
+            setError("Unknown operation: " + std::string(builtinName(op)));
+            return false;
+    }
+}
+
+bool EvaluationContext::callFunction(uint32_t slot) {
+    const Function& func = functions->at(slot);
+    if (!func.defined) {
+        setError("Unknown token in function: " + func.name);
+        return false;
+    }
+    
+    clearError();
+    
+    if (!run(func.code)) {
+        return false;
+    }
+    
+    record(HistoryEntry::Kind::FUNCTION, slot);
+    return true;
+}
+
+bool EvaluationContext::run(const Program& program, double x) {
+    for (const Instruction& instruction : program) {
+        switch (instruction.code) {
+            case OpCode::PUSH:
+                pushValue(instruction.value);
+                break;
+            case OpCode::LOAD_X:
+                pushValue(x);
+                break;
+            case OpCode::BUILTIN:
+                if (!executeBuiltin(static_cast<Builtin>(instruction.index))) {
+                    return false;
+                }
+                break;
+            case OpCode::CALL:
+                if (!callFunction(instruction.index)) {
+                    return false;
+                }
+                break;
+            case OpCode::COPY:
+                if (instruction.index >= stack.size()) {
+                    setError("Invalid index for copy");
+                    return false;
+                }
+                pushValue(stack[stack.size() - 1 - instruction.index]);
+                break;
+            case OpCode::SQUARE:
+                if (stack.empty()) {
+                    setError("Need at least 1 value on stack");
+                    return false;
+                }
+                stack.back() = stack.back() * stack.back();
+                record(HistoryEntry::Kind::BUILTIN, static_cast<uint32_t>(Builtin::Dup));
+                record(HistoryEntry::Kind::BUILTIN, static_cast<uint32_t>(Builtin::Multiply));
+                break;
+            case OpCode::MULTIPLY_ADD: {
+                if (stack.size() < 2) {
+                    setError("Need at least 2 values on stack");
+                    return false;
+                }
+                double product = stack[stack.size() - 2] * stack[stack.size() - 1];
+                stack.pop_back();
+                stack.back() = product + instruction.value;
+                record(HistoryEntry::Kind::BUILTIN, static_cast<uint32_t>(Builtin::Multiply));
+                record(HistoryEntry::Kind::BUILTIN, static_cast<uint32_t>(Builtin::Add));
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool EvaluationContext::evaluate(const Program& program, double x, double& result) {
+    clear();
+    return run(program, x) && popValue(result);
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef EVALUATION_CONTEXT_H
+#define EVALUATION_CONTEXT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Builtins.h"
+#include "FunctionTable.h"
+#include "Program.h"
+#include "RingBuffer.h"
+
+namespace RPN {
+
+// History stores ids and literal values; text is only produced when the
+// history is displayed.
+struct HistoryEntry {
+    enum class Kind : uint8_t {
+        LITERAL,
+        BUILTIN,
+        FUNCTION,
+        DEFINITION
+    };
+    
+    Kind kind;
+    uint32_t id;
+    double value;
+};
+
+// A stack and error slot for running compiled programs. The builtin table
+// is static and the function table is a shared immutable snapshot, so a
+// context is cheap to create, and copying one gives an independent clone
+// for another thread or request.
+class EvaluationContext {
+public:
+    static constexpr size_t DEFAULT_STACK_CAPACITY = 100;
+    
+    explicit EvaluationContext(std::shared_ptr<const FunctionTable> functions,
+                               size_t stackCapacity = DEFAULT_STACK_CAPACITY);
+    
+    void setFunctions(std::shared_ptr<const FunctionTable> table) { functions = std::move(table); }
+    const FunctionTable& getFunctions() const { return *functions; }
+    
+    // Optional sink for executed builtins and calls; not owned.
+    void setHistory(RingBuffer<HistoryEntry>* sink) { history = sink; }
+    
+    void pushValue(double value) { stack.push_back(value); }
+    bool popValue(double& value);
+    void clear();
+    
+    bool executeBuiltin(Builtin op);
+    bool callFunction(uint32_t slot);
+    
+    // Runs program with x bound for LOAD_X, leaving results on the stack.
+    bool run(const Program& program, double x = 0.0);
+    
+    // Clears the stack, runs program and pops its result.
+    bool evaluate(const Program& program, double x, double& result);
+    
+    RingBuffer<double>& getStack() { return stack; }
+    const RingBuffer<double>& getStack() const { return stack; }
+    
+    bool hasError() const { return !errorMessage.empty(); }
+    const std::string& getError() const { return errorMessage; }
+    void setError(const std::string& error) { errorMessage = error; }
+    void clearError() { errorMessage.clear(); }
+
+private:
+    std::shared_ptr<const FunctionTable> functions;
+    RingBuffer<double> stack;
+    std::string errorMessage;
+    RingBuffer<HistoryEntry>* history = nullptr;
+    
+    bool executeStackOperation(Builtin op);
+    void record(HistoryEntry::Kind kind, uint32_t id) {
+        if (history) {
+            history->push_back({kind, id, 0.0});
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "ExpressionCache.h"
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <utility>
+
+namespace RPN {
+
+namespace {
+
+bool isSpace(char ch) {
+    return std::isspace(static_cast<unsigned char>(ch)) != 0;
+}
+
+// Characters that always end a token on their own, so spaces beside them
+// carry no meaning. + and - are left out: "1e - 5" is not "1e-5".
+bool isSeparator(char ch) {
+    return ch == '*' || ch == '/' || ch == '%' || ch == '^' || ch == '(' || ch == ')';
+}
+
+}
+
+size_t ExpressionCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<std::string>()(key.text);
+    return hash * 31 + std::hash<uint64_t>()(key.functionsVersion);
+}
+
+ExpressionCache::ExpressionCache(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1)) {
+}
+
+std::string ExpressionCache::Normalize(std::string_view expr) {
+    std::string normalized;
+    normalized.reserve(expr.size());
+    bool pendingSpace = false;
+    for (char ch : expr) {
+        if (isSpace(ch)) {
+            pendingSpace = !normalized.empty();
+            continue;
+        }
+        if (pendingSpace && !isSeparator(ch) && !isSeparator(normalized.back())) {
+            normalized += ' ';
+        }
+        pendingSpace = false;
+        normalized += ch;
+    }
+    return normalized;
+}
+
+std::shared_ptr<const CompiledExpression> ExpressionCache::Find(const std::string& key,
+                                                                uint64_t functionsVersion) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = lookup.find({key, functionsVersion});
+    if (found == lookup.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->compiled;
+}
+
+void ExpressionCache::Insert(const std::string& key, uint64_t functionsVersion,
+                             std::shared_ptr<const CompiledExpression> compiled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Key full{key, functionsVersion};
+    auto found = lookup.find(full);
+    if (found != lookup.end()) {
+        found->second->compiled = std::move(compiled);
+        entries.splice(entries.begin(), entries, found->second);
+        return;
+    }
+
+    entries.push_front({full, std::move(compiled)});
+    lookup.emplace(std::move(full), entries.begin());
+    while (entries.size() > capacity) {
+        lookup.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+void ExpressionCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lookup.clear();
+    entries.clear();
+}
+
+size_t ExpressionCache::GetSize() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+size_t ExpressionCache::GetHits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hits;
+}
+
+size_t ExpressionCache::GetMisses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return misses;
+}
+
+ExpressionCache& ExpressionCache::Shared() {
+    static ExpressionCache cache;
+    return cache;
+}
+
+}
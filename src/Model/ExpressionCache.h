@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "BatchEvaluator.h"
+#include "Program.h"
+
+namespace RPN {
+
+// An infix expression compiled against one function table: the program
+// the interpreter runs and the batch evaluator built from it.
+struct CompiledExpression {
+    Program program;
+    BatchEvaluator batch;
+};
+
+// Recently compiled expressions, keyed by normalized expression text and
+// function table version, so switching back to an expression seen before
+// skips parsing and batch compilation. The least recently used entries
+// are dropped once the cache holds more than its capacity. All members
+// may be called from any thread.
+class ExpressionCache {
+public:
+    explicit ExpressionCache(size_t capacity = 64);
+
+    ExpressionCache(const ExpressionCache&) = delete;
+    ExpressionCache& operator=(const ExpressionCache&) = delete;
+
+    // The expression with whitespace trimmed, runs of it collapsed to one
+    // space and spaces next to * / % ^ and parentheses removed, which
+    // never changes how it parses.
+    static std::string Normalize(std::string_view expr);
+
+    // Entry for a normalized expression, or nullptr.
+    std::shared_ptr<const CompiledExpression> Find(const std::string& key, uint64_t functionsVersion);
+    void Insert(const std::string& key, uint64_t functionsVersion,
+                std::shared_ptr<const CompiledExpression> compiled);
+    void Clear();
+
+    size_t GetSize() const;
+    size_t GetCapacity() const { return capacity; }
+    // Lookups answered from the cache and lookups that missed, since
+    // construction
+    size_t GetHits() const;
+    size_t GetMisses() const;
+
+    // Process-wide cache used by GraphFunction unless given another.
+    static ExpressionCache& Shared();
+
+private:
+    struct Key {
+        std::string text;
+        uint64_t functionsVersion;
+
+        bool operator==(const Key& other) const {
+            return functionsVersion == other.functionsVersion && text == other.text;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        Key key;
+        std::shared_ptr<const CompiledExpression> compiled;
+    };
+
+    mutable std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+    size_t capacity;
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+}
@@ -0,0 +1,249 @@
+#include "ExpressionTree.h"
+#include <algorithm>
+#include <cstring>
+
+namespace RPN {
+
+namespace {
+
+// Rough interpreter cost of an operation, in instruction dispatches: a
+// libm call takes about as long again as the dispatch itself
+size_t operationCost(Builtin op) {
+    switch (op) {
+        case Builtin::Sin:
+        case Builtin::Cos:
+        case Builtin::Tan:
+        case Builtin::Exp:
+        case Builtin::Ln:
+        case Builtin::Log:
+        case Builtin::Power:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// Keeps costs finite for graphs whose expansion would be huge
+constexpr size_t MAX_COST = size_t(1) << 32;
+
+bool isUnary(Builtin op) {
+    return builtinArity(op) == Arity::UNARY;
+}
+
+}
+
+ExpressionTree::ExpressionTree() {
+    clear();
+}
+
+void ExpressionTree::clear() {
+    nodes.clear();
+    constantIndex.clear();
+    operationIndex.clear();
+    nodes.push_back({Kind::X, Builtin::Add, 0, 0, 0.0});
+}
+
+uint32_t ExpressionTree::constant(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = constantIndex.find(bits);
+    if (it != constantIndex.end()) {
+        return it->second;
+    }
+    uint32_t node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({Kind::CONSTANT, Builtin::Add, 0, 0, value});
+    constantIndex.emplace(bits, node);
+    return node;
+}
+
+uint32_t ExpressionTree::operation(Builtin op, uint32_t a, uint32_t b) {
+    bool unary = isUnary(op);
+    if (unary) {
+        b = a;
+    }
+
+    if (nodes[a].kind == Kind::CONSTANT && nodes[b].kind == Kind::CONSTANT) {
+        double result;
+        const char* error = unary ? applyUnary(op, nodes[a].value, result)
+                                  : applyBinary(op, nodes[a].value, nodes[b].value, result);
+        if (!error) {
+            return constant(result);
+        }
+    }
+
+    uint32_t node;
+    if (simplify(op, a, b, node)) {
+        return node;
+    }
+
+    // Addition and multiplication give the same bits either way round.
+    // Expressions never come near 2^28 nodes.
+    uint64_t first = a, second = b;
+    if ((op == Builtin::Add || op == Builtin::Multiply) && second < first) {
+        std::swap(first, second);
+    }
+    uint64_t key = (uint64_t(op) << 56) | (first << 28) | second;
+    auto it = operationIndex.find(key);
+    if (it != operationIndex.end()) {
+        return it->second;
+    }
+    node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({Kind::OPERATION, op, a, b, 0.0});
+    operationIndex.emplace(key, node);
+    return node;
+}
+
+bool ExpressionTree::isConstant(uint32_t node, double value) const {
+    return nodes[node].kind == Kind::CONSTANT && nodes[node].value == value;
+}
+
+bool ExpressionTree::simplify(Builtin op, uint32_t a, uint32_t b, uint32_t& node) {
+    switch (op) {
+        case Builtin::Add:
+            if (isConstant(b, 0.0)) {
+                node = a;
+                return true;
+            }
+            if (isConstant(a, 0.0)) {
+                node = b;
+                return true;
+            }
+            return false;
+        case Builtin::Subtract:
+            if (isConstant(b, 0.0)) {
+                node = a;
+                return true;
+            }
+            return false;
+        case Builtin::Multiply:
+            if (isConstant(b, 1.0)) {
+                node = a;
+                return true;
+            }
+            if (isConstant(a, 1.0)) {
+                node = b;
+                return true;
+            }
+            return false;
+        case Builtin::Divide:
+            if (isConstant(b, 1.0)) {
+                node = a;
+                return true;
+            }
+            return false;
+        case Builtin::Power:
+            if (isConstant(b, 1.0)) {
+                node = a;
+                return true;
+            }
+            if (isConstant(b, 2.0)) {
+                node = operation(Builtin::Multiply, a, a);
+                return true;
+            }
+            return false;
+        case Builtin::Negate:
+            if (nodes[a].kind == Kind::OPERATION && nodes[a].op == Builtin::Negate) {
+                node = nodes[a].a;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+void ExpressionTree::emit(uint32_t root, size_t stackCapacity, Program& program) {
+    planSharing(root);
+    emitProgram(root, program);
+    if (maxDepth > stackCapacity && !kept.empty()) {
+        kept.clear();
+        std::fill(slots.begin(), slots.end(), NO_SLOT);
+        emitProgram(root, program);
+    }
+}
+
+// Counts how often each node would be evaluated and picks the shared ones
+// worth keeping. Operands always have lower numbers than the operations
+// using them, so walking down from the root sees every use of a node
+// before the node itself.
+void ExpressionTree::planSharing(uint32_t root) {
+    size_t count = static_cast<size_t>(root) + 1;
+    costs.assign(count, 1);
+    uses.assign(count, 0);
+    slots.assign(count, NO_SLOT);
+    kept.clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        const Node& node = nodes[i];
+        if (node.kind == Kind::OPERATION) {
+            size_t cost = operationCost(node.op) + costs[node.a] + (isUnary(node.op) ? 0 : costs[node.b]);
+            costs[i] = std::min(cost, MAX_COST);
+        }
+    }
+
+    uses[root] = 1;
+    for (size_t i = count; i-- > 0;) {
+        const Node& node = nodes[i];
+        if (node.kind != Kind::OPERATION || uses[i] == 0) {
+            continue;
+        }
+        // A kept value is computed once, then each use costs a copy
+        size_t n = uses[i];
+        bool keep = n > 1 && (n - 1) * costs[i] > n;
+        size_t evaluations = keep ? 1 : n;
+        uses[node.a] = std::min(uses[node.a] + evaluations, MAX_COST);
+        if (!isUnary(node.op)) {
+            uses[node.b] = std::min(uses[node.b] + evaluations, MAX_COST);
+        }
+        if (keep) {
+            kept.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    std::reverse(kept.begin(), kept.end());
+}
+
+void ExpressionTree::emitProgram(uint32_t root, Program& program) {
+    program.clear();
+    depth = 0;
+    maxDepth = 0;
+
+    // Kept values go to the bottom of the stack, operands first
+    uint32_t slot = 0;
+    for (uint32_t node : kept) {
+        emitNode(node, program);
+        slots[node] = slot++;
+    }
+    emitNode(root, program);
+}
+
+void ExpressionTree::emitNode(uint32_t index, Program& program) {
+    const Node& node = nodes[index];
+    if (slots[index] != NO_SLOT) {
+        push(program, {OpCode::COPY, static_cast<uint32_t>(depth - 1 - slots[index]), 0.0});
+        return;
+    }
+
+    switch (node.kind) {
+        case Kind::X:
+            push(program, {OpCode::LOAD_X, 0, 0.0});
+            break;
+        case Kind::CONSTANT:
+            push(program, {OpCode::PUSH, 0, node.value});
+            break;
+        case Kind::OPERATION:
+            emitNode(node.a, program);
+            if (!isUnary(node.op)) {
+                emitNode(node.b, program);
+                --depth;
+            }
+            program.push_back({OpCode::BUILTIN, static_cast<uint32_t>(node.op), 0.0});
+            break;
+    }
+}
+
+void ExpressionTree::push(Program& program, Instruction instruction) {
+    program.push_back(instruction);
+    maxDepth = std::max(maxDepth, ++depth);
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef EXPRESSION_TREE_H
+#define EXPRESSION_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Builtins.h"
+#include "Program.h"
+
+namespace RPN {
+
+// Expression graph between parsing and code generation. Nodes are
+// hash-consed, so a subexpression written several times becomes one node,
+// and as nodes are added operations on constants are folded and
+// identities are simplified away:
+//
+//   a*1, 1*a, a/1, a^1, a+0, 0+a, a-0  ->  a
+//   a^2                                ->  a*a
+//   -(-a)                              ->  a
+//
+// All of these give the same value for every a, with two exceptions: a+0
+// and 0+a turn -0 into +0, and a*a is correctly rounded where pow(a, 2)
+// may be an ulp away, so a^2 can differ from the calculator's "^" in the
+// last bit. Folding uses the interpreter's own arithmetic and leaves
+// operations that would fail, such as 1/0, for run time.
+//
+// emit() turns the graph back into a program. Shared nodes that cost
+// more to recompute than to keep are computed once, first, and copied
+// from the bottom of the stack wherever they are used.
+class ExpressionTree {
+public:
+    enum class Kind : uint8_t { X, CONSTANT, OPERATION };
+
+    struct Node {
+        Kind kind;
+        Builtin op;
+        uint32_t a;
+        uint32_t b;
+        double value;
+    };
+
+    ExpressionTree();
+
+    // Removes every node but x.
+    void clear();
+
+    uint32_t x() const { return 0; }
+    uint32_t constant(double value);
+    // op must be a unary or binary builtin; unary operations ignore b.
+    uint32_t operation(Builtin op, uint32_t a, uint32_t b = 0);
+
+    const Node& at(uint32_t node) const { return nodes[node]; }
+    size_t size() const { return nodes.size(); }
+
+    // Replaces program with code that leaves root's value on top of the
+    // stack, with any kept values still beneath it; evaluation only takes
+    // the top. If keeping values would take the stack past stackCapacity,
+    // every use recomputes its value instead.
+    void emit(uint32_t root, size_t stackCapacity, Program& program);
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    std::vector<Node> nodes;
+    std::unordered_map<uint64_t, uint32_t> constantIndex;
+    std::unordered_map<uint64_t, uint32_t> operationIndex;
+
+    // Scratch for emit
+    std::vector<size_t> costs;
+    std::vector<size_t> uses;
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> kept;
+    size_t depth = 0;
+    size_t maxDepth = 0;
+
+    bool isConstant(uint32_t node, double value) const;
+    bool simplify(Builtin op, uint32_t a, uint32_t b, uint32_t& node);
+    void planSharing(uint32_t root);
+    void emitProgram(uint32_t root, Program& program);
+    void emitNode(uint32_t node, Program& program);
+    void push(Program& program, Instruction instruction);
+};
+
+}
+
+#endif
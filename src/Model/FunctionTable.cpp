@@ -0,0 +1,129 @@
+#include "FunctionTable.h"
+#include "ProgramOptimizer.h"
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace RPN {
+
+namespace {
+
+// Shared by all tables, so no two diverging tables ever hold the same
+// version
+std::atomic<uint64_t> lastVersion{0};
+
+bool isInlinable(const Function& function) {
+    return function.defined && function.code.size() <= FunctionTable::MAX_INLINE_SIZE &&
+           std::none_of(function.code.begin(), function.code.end(), [](const Instruction& instruction) {
+               return instruction.code == OpCode::CALL;
+           });
+}
+
+// Rebuilds code for the functions marked PENDING, callees first. A call
+// back into a function still being linked is a cycle and stays a call.
+class Linker {
+public:
+    enum State : uint8_t { UNCHANGED, PENDING, ACTIVE, DONE };
+    
+    Linker(std::vector<Function>& functions, std::vector<uint8_t> state)
+        : functions(functions), state(std::move(state)) {}
+    
+    void linkPending() {
+        for (uint32_t slot = 0; slot < functions.size(); ++slot) {
+            if (state[slot] == PENDING) {
+                link(slot);
+            }
+        }
+    }
+
+private:
+    std::vector<Function>& functions;
+    std::vector<uint8_t> state;
+    
+    void link(uint32_t slot) {
+        state[slot] = ACTIVE;
+        const Program& ownCode = functions[slot].ownCode;
+        Program code;
+        bool inlined = false;
+        for (const Instruction& instruction : ownCode) {
+            if (instruction.code == OpCode::CALL) {
+                uint32_t callee = instruction.index;
+                if (state[callee] == PENDING) {
+                    link(callee);
+                }
+                if (state[callee] != ACTIVE && isInlinable(functions[callee])) {
+                    const Program& body = functions[callee].code;
+                    code.insert(code.end(), body.begin(), body.end());
+                    inlined = true;
+                    continue;
+                }
+            }
+            code.push_back(instruction);
+        }
+        // Inlined code gives the optimizer new neighbours to work on
+        functions[slot].code = inlined ? optimizeProgram(code) : ownCode;
+        state[slot] = DONE;
+    }
+};
+
+}
+
+uint32_t FunctionTable::declare(const std::string& name) {
+    auto it = index.find(name);
+    if (it != index.end()) {
+        return it->second;
+    }
+    
+    uint32_t slot = static_cast<uint32_t>(functions.size());
+    functions.emplace_back(name, std::vector<std::string>());
+    index.emplace(name, slot);
+    return slot;
+}
+
+void FunctionTable::define(uint32_t slot, const std::vector<std::string>& body, Program code) {
+    Function& func = functions[slot];
+    func.body = body;
+    func.ownCode = std::move(code);
+    func.defined = true;
+    relink(slot);
+    version = lastVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void FunctionTable::relink(uint32_t slot) {
+    std::vector<std::vector<uint32_t>> callers(functions.size());
+    for (uint32_t caller = 0; caller < functions.size(); ++caller) {
+        for (const Instruction& instruction : functions[caller].ownCode) {
+            if (instruction.code == OpCode::CALL) {
+                callers[instruction.index].push_back(caller);
+            }
+        }
+    }
+    
+    // Only slot and the functions that reach it can have inlined its code
+    std::vector<uint8_t> state(functions.size(), Linker::UNCHANGED);
+    std::vector<uint32_t> pending{slot};
+    state[slot] = Linker::PENDING;
+    while (!pending.empty()) {
+        uint32_t callee = pending.back();
+        pending.pop_back();
+        for (uint32_t caller : callers[callee]) {
+            if (state[caller] == Linker::UNCHANGED) {
+                state[caller] = Linker::PENDING;
+                pending.push_back(caller);
+            }
+        }
+    }
+    
+    Linker(functions, std::move(state)).linkPending();
+}
+
+bool FunctionTable::find(std::string_view name, uint32_t& slot) const {
+    auto it = index.find(name);
+    if (it == index.end() || !functions[it->second].defined) {
+        return false;
+    }
+    slot = it->second;
+    return true;
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef FUNCTION_TABLE_H
+#define FUNCTION_TABLE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Program.h"
+
+namespace RPN {
+
+struct Function {
+    std::string name;
+    std::vector<std::string> body;
+    // What runs: ownCode with small callees inlined
+    Program code;
+    // The body as compiled, calls and all; code is rebuilt from it when
+    // a function it calls is defined or redefined
+    Program ownCode;
+    bool defined = false;
+    
+    Function() = default;
+    Function(const std::string& n, const std::vector<std::string>& b)
+        : name(n), body(b) {}
+};
+
+// User functions indexed by slot. Slots are never removed or reordered,
+// so compiled CALL instructions stay valid in copies of the table.
+//
+// A call to a defined function whose code makes no calls of its own and
+// is at most MAX_INLINE_SIZE instructions is replaced by that code, which
+// saves the call and lets the optimizer work across it. Recursive
+// functions always make a call, so they are never inlined.
+class FunctionTable {
+public:
+    static constexpr size_t MAX_INLINE_SIZE = 16;
+    
+    // Returns the slot for name, adding an undefined slot if needed.
+    uint32_t declare(const std::string& name);
+    // Stores the compiled body and re-inlines it into every function that
+    // calls it, directly or through others.
+    void define(uint32_t slot, const std::vector<std::string>& body, Program code);
+    
+    // Finds a defined function.
+    bool find(std::string_view name, uint32_t& slot) const;
+    
+    const Function& at(uint32_t slot) const { return functions[slot]; }
+    const std::vector<Function>& all() const { return functions; }
+    size_t size() const { return functions.size(); }
+    
+    // Changes on every definition; lets caches detect stale compilations.
+    // Versions are unique across tables, so tables with equal versions
+    // hold the same definitions (one is a copy of the other).
+    uint64_t getVersion() const { return version; }
+
+private:
+    std::vector<Function> functions;
+    std::map<std::string, uint32_t, std::less<>> index;
+    uint64_t version = 0;
+    
+    // Rebuilds code for slot and its callers
+    void relink(uint32_t slot);
+};
+
+}
+
+#endif
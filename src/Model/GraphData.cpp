@@ -1,43 +1,185 @@
 #include "GraphData.h"
+#include "SimdMath.h"
 #include <limits>
 #include <algorithm>
+#include <cmath>
+#include <utility>
 
 namespace RPN {
 
+namespace {
+
+// Vectorized min/max with std::min/std::max semantics, so NaN entries are
+// skipped exactly as a scalar loop would skip them.
+void MinMax(const std::vector<double>& values, double& low, double& high) {
+    using Simd::Vec;
+    const double* data = values.data();
+    size_t count = values.size();
+    
+    Vec low0 = Vec::broadcast(std::numeric_limits<double>::max()), low1 = low0;
+    Vec high0 = Vec::broadcast(std::numeric_limits<double>::lowest()), high1 = high0;
+    size_t i = 0;
+    for (; i + 2 * Vec::WIDTH <= count; i += 2 * Vec::WIDTH) {
+        Vec a = Vec::load(data + i);
+        Vec b = Vec::load(data + i + Vec::WIDTH);
+        low0 = Simd::min(low0, a);
+        low1 = Simd::min(low1, b);
+        high0 = Simd::max(high0, a);
+        high1 = Simd::max(high1, b);
+    }
+    
+    double lows[Vec::WIDTH], highs[Vec::WIDTH];
+    Simd::min(low0, low1).store(lows);
+    Simd::max(high0, high1).store(highs);
+    low = lows[0];
+    high = highs[0];
+    for (int lane = 1; lane < Vec::WIDTH; ++lane) {
+        low = std::min(low, lows[lane]);
+        high = std::max(high, highs[lane]);
+    }
+    for (; i < count; ++i) {
+        low = std::min(low, data[i]);
+        high = std::max(high, data[i]);
+    }
+}
+
+// Samples per bucket when building a level; two of them survive
+constexpr size_t LOD_BUCKET = 8;
+// Levels stop once they are this small
+constexpr size_t LOD_MIN_LEVEL = 1024;
+
+// Keeps the lowest and highest y of every bucket, in their original order.
+// NaN only survives when the whole bucket is NaN, so gaps stay visible.
+void Decimate(const std::vector<double>& xIn, const std::vector<double>& yIn,
+              std::vector<double>& xOut, std::vector<double>& yOut) {
+    size_t count = xIn.size();
+    size_t buckets = (count + LOD_BUCKET - 1) / LOD_BUCKET;
+    xOut.resize(2 * buckets);
+    yOut.resize(2 * buckets);
+    
+    for (size_t b = 0; b < buckets; ++b) {
+        size_t begin = b * LOD_BUCKET;
+        size_t end = std::min(begin + LOD_BUCKET, count);
+        size_t low = begin, high = begin;
+        for (size_t i = begin + 1; i < end; ++i) {
+            if (yIn[i] < yIn[low] || std::isnan(yIn[low])) {
+                low = i;
+            }
+            if (yIn[i] > yIn[high] || std::isnan(yIn[high])) {
+                high = i;
+            }
+        }
+        size_t first = std::min(low, high), second = std::max(low, high);
+        xOut[2 * b] = xIn[first];
+        yOut[2 * b] = yIn[first];
+        xOut[2 * b + 1] = xIn[second];
+        yOut[2 * b + 1] = yIn[second];
+    }
+}
+
+}
+
 void GraphData::Clear() {
-    points.clear();
+    xs.clear();
+    ys.clear();
+    boundsValid = false;
+    levels.clear();
 }
 
 void GraphData::AddPoint(double x, double y) {
-    points.push_back({x, y});
+    if (boundsValid) {
+        if (xs.empty()) {
+            minX = minY = std::numeric_limits<double>::max();
+            maxX = maxY = std::numeric_limits<double>::lowest();
+        }
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    }
+    xs.push_back(x);
+    ys.push_back(y);
+    levels.clear();
 }
 
-void GraphData::SetData(const std::vector<double>& xData, const std::vector<double>& yData) {
-    points.clear();
-    
+void GraphData::SetData(std::vector<double> xData, std::vector<double> yData) {
     size_t minSize = std::min(xData.size(), yData.size());
-    points.reserve(minSize);
+    xData.resize(minSize);
+    yData.resize(minSize);
+    xs = std::move(xData);
+    ys = std::move(yData);
+    boundsValid = false;
+    BuildLevels();
+}
+
+void GraphData::GetBounds(double& xMin, double& xMax, double& yMin, double& yMax) const {
+    if (!boundsValid) {
+        UpdateBounds();
+    }
+    xMin = minX;
+    xMax = maxX;
+    yMin = minY;
+    yMax = maxY;
+}
+
+void GraphData::UpdateBounds() const {
+    if (xs.empty()) {
+        minX = maxX = minY = maxY = 0.0;
+    } else {
+        MinMax(xs, minX, maxX);
+        MinMax(ys, minY, maxY);
+    }
+    boundsValid = true;
+}
+
+GraphData::View GraphData::GetLevelOfDetail(double xMin, double xMax, size_t pixels) const {
+    View view{xs.data(), ys.data(), xs.size()};
+    if (levels.empty() || pixels == 0) {
+        return view;
+    }
+    
+    size_t visible = std::upper_bound(xs.begin(), xs.end(), xMax) -
+                     std::lower_bound(xs.begin(), xs.end(), xMin);
+    for (const Level& level : levels) {
+        if (visible / level.stride < 2 * pixels) {
+            break;
+        }
+        view = {level.xs.data(), level.ys.data(), level.xs.size()};
+    }
     
-    for (size_t i = 0; i < minSize; ++i) {
-        points.push_back({xData[i], yData[i]});
+    // Keep one sample either side of the range so the line runs off the
+    // edges of the plot instead of stopping short
+    const double* end = view.x + view.count;
+    const double* first = std::lower_bound(view.x, end, xMin);
+    const double* last = std::upper_bound(first, end, xMax);
+    if (first != view.x) {
+        --first;
     }
+    if (last != end) {
+        ++last;
+    }
+    size_t offset = first - view.x;
+    return {first, view.y + offset, static_cast<size_t>(last - first)};
 }
 
-void GraphData::GetBounds(double& xMin, double& xMax, double& yMin, double& yMax) const {
-    if (points.empty()) {
-        xMin = xMax = yMin = yMax = 0.0;
+void GraphData::BuildLevels() {
+    levels.clear();
+    if (xs.size() <= LOD_MIN_POINTS || !std::is_sorted(xs.begin(), xs.end())) {
         return;
     }
     
-    xMin = yMin = std::numeric_limits<double>::max();
-    xMax = yMax = std::numeric_limits<double>::lowest();
-    
-    for (const auto& point : points) {
-        xMin = std::min(xMin, point.x);
-        xMax = std::max(xMax, point.x);
-        yMin = std::min(yMin, point.y);
-        yMax = std::max(yMax, point.y);
+    const std::vector<double>* xIn = &xs;
+    const std::vector<double>* yIn = &ys;
+    size_t stride = 1;
+    while (xIn->size() > LOD_MIN_LEVEL) {
+        stride *= LOD_BUCKET / 2;
+        Level next;
+        Decimate(*xIn, *yIn, next.xs, next.ys);
+        next.stride = stride;
+        levels.push_back(std::move(next));
+        xIn = &levels.back().xs;
+        yIn = &levels.back().ys;
     }
 }
 
-}
\ No newline at end of file
+}
@@ -4,31 +4,76 @@
 
 namespace RPN {
 
+// One plotted series. x and y live in separate contiguous arrays so a
+// plot can read them in place, without repacking every frame.
 class GraphData {
 public:
     struct Point {
         double x;
         double y;
     };
+    
+    // A contiguous run of samples to hand to the plot
+    struct View {
+        const double* x;
+        const double* y;
+        size_t count;
+    };
+    
+    // Series at or below this size are always plotted in full
+    static constexpr size_t LOD_MIN_POINTS = 4096;
 
     GraphData() = default;
     
     void Clear();
     void AddPoint(double x, double y);
-    void SetData(const std::vector<double>& xData, const std::vector<double>& yData);
+    // Takes ownership of the arrays; the longer one is truncated.
+    void SetData(std::vector<double> xData, std::vector<double> yData);
     
-    const std::vector<Point>& GetPoints() const { return points; }
-    bool IsEmpty() const { return points.empty(); }
-    size_t GetSize() const { return points.size(); }
+    const std::vector<double>& GetX() const { return xs; }
+    const std::vector<double>& GetY() const { return ys; }
+    Point GetPoint(size_t i) const { return {xs[i], ys[i]}; }
+    bool IsEmpty() const { return xs.empty(); }
+    size_t GetSize() const { return xs.size(); }
     
+    // Cached: AddPoint widens the bounds in place and SetData marks them
+    // stale, so only the first call after SetData scans the arrays.
     void GetBounds(double& xMin, double& xMax, double& yMin, double& yMax) const;
     
+    // The samples to draw for [xMin, xMax] on a plot `pixels` wide. Large
+    // series sorted by x keep a pyramid of min/max decimations, each level
+    // a quarter the size of the one below. SetData builds it, on the
+    // thread that produced the samples; AddPoint drops it, so a series
+    // assembled point by point is drawn in full. The coarsest level that
+    // still has two samples per pixel column is chosen and trimmed to the
+    // visible range, so the envelope of the curve is kept and the cost of
+    // a frame depends on the plot width rather than the series size.
+    View GetLevelOfDetail(double xMin, double xMax, size_t pixels) const;
+    
     void SetLabel(const std::string& label) { this->label = label; }
     const std::string& GetLabel() const { return label; }
 
 private:
-    std::vector<Point> points;
+    std::vector<double> xs;
+    std::vector<double> ys;
     std::string label;
+    
+    mutable bool boundsValid = true;
+    mutable double minX = 0.0, maxX = 0.0, minY = 0.0, maxY = 0.0;
+    
+    void UpdateBounds() const;
+    
+    // levels[0] keeps the lowest and highest sample of every bucket of 8
+    // raw samples, in x order; each further level does the same to the
+    // one before it
+    struct Level {
+        std::vector<double> xs;
+        std::vector<double> ys;
+        size_t stride;    // raw samples per kept sample
+    };
+    std::vector<Level> levels;
+    
+    void BuildLevels();
 };
 
-}
\ No newline at end of file
+}
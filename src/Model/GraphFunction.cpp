@@ -1,14 +1,24 @@
 #include "GraphFunction.h"
 #include "CalculatorModel.h"
+#include "ExpressionCache.h"
 #include "InfixToRPN.h"
+#include "ThreadPool.h"
 #include <sstream>
 #include <cmath>
 #include <algorithm>
-#include <regex>
+#include <limits>
 
 namespace RPN {
 
-GraphFunction::GraphFunction(CalculatorModel* calc) : calculator(calc) {}
+GraphFunction::GraphFunction(CalculatorModel* calc)
+    : calculator(calc), context(calc->createContext()) {}
+
+GraphFunction::GraphFunction(std::shared_ptr<const FunctionTable> functions)
+    : calculator(nullptr), pinnedFunctions(functions), context(std::move(functions)) {}
+
+void GraphFunction::SetFunctions(std::shared_ptr<const FunctionTable> functions) {
+    pinnedFunctions = std::move(functions);
+}
 
 bool GraphFunction::SetExpression(const std::string& expr) {
     if (!IsValidExpression(expr)) {
@@ -16,7 +26,25 @@ bool GraphFunction::SetExpression(const std::string& expr) {
         return false;
     }
     
+    auto functions = GetFunctions();
+    ExpressionCache& cache = expressionCache ? *expressionCache : ExpressionCache::Shared();
+    std::string key = ExpressionCache::Normalize(expr);
+    auto compiled = cache.Find(key, functions->getVersion());
+    if (!compiled) {
+        auto fresh = std::make_shared<CompiledExpression>();
+        if (!Compile(expr, *functions, fresh->program)) {
+            return false;
+        }
+        fresh->batch.compile(fresh->program, *functions, context.getStack().capacity());
+        cache.Insert(key, functions->getVersion(), fresh);
+        compiled = std::move(fresh);
+    }
+    
     expression = expr;
+    program = compiled->program;
+    batch = compiled->batch;
+    context.setFunctions(functions);
+    batchFunctions = std::move(functions);
     lastError.clear();
     return true;
 }
@@ -34,48 +62,244 @@ std::shared_ptr<GraphData> GraphFunction::Evaluate(double xMin, double xMax, int
         return data;
     }
     
+    RefreshFunctions();
+    
     double step = (xMax - xMin) / (numPoints - 1);
-    std::vector<double> xValues, yValues;
-    xValues.reserve(numPoints);
-    yValues.reserve(numPoints);
+    size_t count = static_cast<size_t>(numPoints);
+    std::vector<double> xValues(count), yValues(count);
+    for (size_t i = 0; i < count; ++i) {
+        xValues[i] = xMin + i * step;
+    }
     
-    for (int i = 0; i < numPoints; ++i) {
-        double x = xMin + i * step;
-        double y = EvaluateAtPoint(x);
-        
-        if (!std::isnan(y) && !std::isinf(y)) {
-            xValues.push_back(x);
-            yValues.push_back(y);
+    // Every sample is independent, so chunks write straight into their
+    // slots and the result does not depend on how the range was split.
+    ThreadPool& workers = pool ? *pool : ThreadPool::shared();
+    if (count >= PARALLEL_THRESHOLD && workers.size() > 1) {
+        std::vector<BatchEvaluator> evaluators(workers.size(), batch);
+        std::vector<EvaluationContext> contexts(workers.size(), context);
+        workers.parallelFor(count, PARALLEL_GRAIN, [&](size_t begin, size_t end, unsigned worker) {
+            Sample(evaluators[worker], contexts[worker], &xValues[begin], &yValues[begin], end - begin);
+        });
+    } else {
+        Sample(batch, context, xValues.data(), yValues.data(), count);
+    }
+    evaluationCount += count;
+    
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!std::isnan(yValues[i]) && !std::isinf(yValues[i])) {
+            xValues[kept] = xValues[i];
+            yValues[kept] = yValues[i];
+            ++kept;
         }
     }
+    xValues.resize(kept);
+    yValues.resize(kept);
     
-    data->SetData(xValues, yValues);
+    data->SetData(std::move(xValues), std::move(yValues));
     data->SetLabel(expression);
     
     return data;
 }
 
-double GraphFunction::EvaluateAtPoint(double x) {
-    calculator->clear();
+namespace {
+
+// Distance in pixels from the midpoint sample to the chord between the
+// interval's ends.
+double ChordDeviation(double x0, double y0, double xm, double ym, double x1, double y1,
+                      double xPixel, double yPixel) {
+    double ax = (x1 - x0) / xPixel, ay = (y1 - y0) / yPixel;
+    double bx = (xm - x0) / xPixel, by = (ym - y0) / yPixel;
+    double length = std::hypot(ax, ay);
+    if (length == 0.0) {
+        return std::hypot(bx, by);
+    }
+    return std::abs(ax * by - ay * bx) / length;
+}
+
+}
+
+std::shared_ptr<GraphData> GraphFunction::EvaluateAdaptive(double xMin, double xMax,
+                                                           const SamplingOptions& options) {
+    auto data = std::make_shared<GraphData>();
+    
+    if (expression.empty()) {
+        lastError = "No expression set";
+        return data;
+    }
     
-    std::string preparedExpr = PrepareExpression(expression, x);
+    size_t seeds = std::max<size_t>(options.initialSamples, 2);
+    size_t budget = std::max(options.maxSamples, seeds);
     
-    std::vector<std::string> rpnTokens = InfixToRPN::convert(preparedExpr);
+    RefreshFunctions();
     
-    for (const auto& token : rpnTokens) {
-        try {
-            double value = std::stod(token);
-            calculator->pushValue(value);
-        } catch (...) {
-            if (!calculator->executeOperation(token) && 
-                calculator->isFunctionDefined(token)) {
-                calculator->executeFunction(token);
+    std::vector<double> xs(seeds), ys(seeds);
+    double seedStep = (xMax - xMin) / (seeds - 1);
+    for (size_t i = 0; i < seeds; ++i) {
+        xs[i] = xMin + i * seedStep;
+    }
+    Sample(batch, context, xs.data(), ys.data(), seeds);
+    evaluationCount += seeds;
+    
+    double xPixel = options.xPixel > 0.0 ? options.xPixel : (xMax - xMin) / 1000.0;
+    double yPixel = options.yPixel;
+    if (yPixel <= 0.0) {
+        double low = std::numeric_limits<double>::max();
+        double high = std::numeric_limits<double>::lowest();
+        for (double y : ys) {
+            if (std::isfinite(y)) {
+                low = std::min(low, y);
+                high = std::max(high, y);
+            }
+        }
+        yPixel = high > low ? (high - low) / 1000.0 : 1.0;
+    }
+    double minWidth = std::abs(xPixel) * 0.25;
+    
+    // Each interval i spans xs[i]..xs[i + 1]. Flagged intervals get their
+    // midpoint sampled on the next pass, most deviant first.
+    const double always = std::numeric_limits<double>::infinity();
+    std::vector<double> priority(seeds - 1, always);
+    std::vector<size_t> candidates;
+    std::vector<double> midX, midY;
+    std::vector<double> nextX, nextY, nextPriority;
+    
+    while (xs.size() < budget) {
+        candidates.clear();
+        for (size_t i = 0; i + 1 < xs.size(); ++i) {
+            if (priority[i] > 0.0 && std::abs(xs[i + 1] - xs[i]) > minWidth) {
+                candidates.push_back(i);
+            }
+        }
+        if (candidates.empty()) {
+            break;
+        }
+        
+        size_t room = budget - xs.size();
+        if (candidates.size() > room) {
+            std::nth_element(candidates.begin(), candidates.begin() + room, candidates.end(),
+                             [&](size_t a, size_t b) { return priority[a] > priority[b]; });
+            candidates.resize(room);
+            std::sort(candidates.begin(), candidates.end());
+        }
+        
+        midX.resize(candidates.size());
+        midY.resize(candidates.size());
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            size_t i = candidates[c];
+            midX[c] = 0.5 * (xs[i] + xs[i + 1]);
+        }
+        Sample(batch, context, midX.data(), midY.data(), midX.size());
+        evaluationCount += midX.size();
+        
+        // Merge the midpoints in and decide which halves to look at again
+        nextX.clear();
+        nextY.clear();
+        nextPriority.clear();
+        size_t c = 0;
+        for (size_t i = 0; i + 1 < xs.size(); ++i) {
+            nextX.push_back(xs[i]);
+            nextY.push_back(ys[i]);
+            if (c == candidates.size() || candidates[c] != i) {
+                nextPriority.push_back(0.0);
+                continue;
+            }
+            
+            double xm = midX[c], ym = midY[c];
+            ++c;
+            bool leftFinite = std::isfinite(ys[i]);
+            bool midFinite = std::isfinite(ym);
+            bool rightFinite = std::isfinite(ys[i + 1]);
+            
+            double score = 0.0;
+            if (leftFinite && midFinite && rightFinite) {
+                score = ChordDeviation(xs[i], ys[i], xm, ym, xs[i + 1], ys[i + 1], xPixel, yPixel);
+                if (score <= options.tolerance) {
+                    score = 0.0;
+                }
+            } else if (leftFinite || midFinite || rightFinite) {
+                score = always;
             }
+            
+            // Halves with no finite end have nothing to draw
+            nextPriority.push_back(leftFinite || midFinite ? score : 0.0);
+            nextX.push_back(xm);
+            nextY.push_back(ym);
+            nextPriority.push_back(midFinite || rightFinite ? score : 0.0);
+        }
+        nextX.push_back(xs.back());
+        nextY.push_back(ys.back());
+        
+        xs.swap(nextX);
+        ys.swap(nextY);
+        priority.swap(nextPriority);
+    }
+    
+    size_t kept = 0;
+    for (size_t i = 0; i < xs.size(); ++i) {
+        if (std::isfinite(ys[i])) {
+            xs[kept] = xs[i];
+            ys[kept] = ys[i];
+            ++kept;
         }
     }
+    xs.resize(kept);
+    ys.resize(kept);
+    
+    data->SetData(std::move(xs), std::move(ys));
+    data->SetLabel(expression);
+    
+    return data;
+}
+
+void GraphFunction::EvaluateBatch(const double* x, double* y, size_t count) {
+    if (program.empty()) {
+        std::fill_n(y, count, std::numeric_limits<double>::quiet_NaN());
+        return;
+    }
+    
+    RefreshFunctions();
+    Sample(batch, context, x, y, count);
+    evaluationCount += count;
+}
+
+uint64_t GraphFunction::GetFunctionsVersion() const {
+    return GetFunctions()->getVersion();
+}
+
+std::shared_ptr<const FunctionTable> GraphFunction::GetFunctions() const {
+    return calculator ? calculator->snapshotFunctions() : pinnedFunctions;
+}
+
+void GraphFunction::RefreshFunctions() {
+    auto snapshot = GetFunctions();
+    if (snapshot == batchFunctions) {
+        return;
+    }
     
+    context.setFunctions(snapshot);
+    batch.compile(program, *snapshot, context.getStack().capacity());
+    batchFunctions = std::move(snapshot);
+}
+
+void GraphFunction::Sample(BatchEvaluator& evaluator, EvaluationContext& ctx,
+                           const double* x, double* y, size_t count) const {
+    if (evaluator.isCompiled()) {
+        evaluator.evaluate(x, y, count);
+        return;
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (!ctx.evaluate(program, x[i], y[i])) {
+            y[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+}
+
+double GraphFunction::EvaluateAtPoint(double x) {
+    ++evaluationCount;
     double result = 0.0;
-    if (!calculator->popValue(result)) {
+    if (!context.evaluate(program, x, result)) {
         return std::numeric_limits<double>::quiet_NaN();
     }
     
@@ -88,13 +312,86 @@ bool GraphFunction::IsValidExpression(const std::string& expr) {
     return expr.find('x') != std::string::npos || expr.find('X') != std::string::npos;
 }
 
-std::string GraphFunction::PrepareExpression(const std::string& expr, double xValue) {
-    std::string result = expr;
+bool GraphFunction::Compile(const std::string& expr, const FunctionTable& functions, Program& compiled) {
+    compiled.clear();
+    if (!parser.parse(expr)) {
+        lastError = "Mismatched parentheses";
+        return false;
+    }
+    const auto& rpnTokens = parser.tokens();
+    compiled.reserve(rpnTokens.size());
     
-    std::regex xRegex("\\b[xX]\\b");
-    result = std::regex_replace(result, xRegex, std::to_string(xValue));
+    // Track stack depth so malformed expressions fail here rather than
+    // producing garbage per sample. Calls have unknown stack effect.
+    // While the depth is known the expression is also built as a tree,
+    // which is simplified and emitted in place of the plain program.
+    int depth = 0;
+    bool checkDepth = true;
+    tree.clear();
+    operands.clear();
     
-    return result;
+    for (const auto& token : rpnTokens) {
+        Builtin op;
+        uint32_t slot;
+        
+        if (token.kind == InfixToRPN::TokenKind::NUMBER) {
+            compiled.push_back({OpCode::PUSH, 0, token.value});
+            operands.push_back(tree.constant(token.value));
+            ++depth;
+        } else if (token.text == "x" || token.text == "X") {
+            compiled.push_back({OpCode::LOAD_X, 0, 0.0});
+            operands.push_back(tree.x());
+            ++depth;
+        } else if (token.kind == InfixToRPN::TokenKind::OPERATOR || findBuiltin(token.text, op)) {
+            if (token.kind == InfixToRPN::TokenKind::OPERATOR) {
+                op = token.op;
+            }
+            compiled.push_back({OpCode::BUILTIN, static_cast<uint32_t>(op), 0.0});
+            switch (builtinArity(op)) {
+                case Arity::UNARY:
+                    if (depth >= 1) {
+                        operands.back() = tree.operation(op, operands.back());
+                    } else {
+                        depth = -1;
+                    }
+                    break;
+                case Arity::BINARY:
+                    if (depth >= 2) {
+                        uint32_t b = operands.back();
+                        operands.pop_back();
+                        operands.back() = tree.operation(op, operands.back(), b);
+                        --depth;
+                    } else {
+                        depth = -1;
+                    }
+                    break;
+                case Arity::STACK:
+                    checkDepth = false;
+                    break;
+            }
+        } else if (functions.find(token.text, slot)) {
+            compiled.push_back({OpCode::CALL, slot, 0.0});
+            checkDepth = false;
+        } else {
+            lastError = "Unknown identifier: " + std::string(token.text);
+            return false;
+        }
+        
+        if (checkDepth && depth < 0) {
+            lastError = "Missing operand for " + std::string(token.text);
+            return false;
+        }
+    }
+    
+    if (compiled.empty() || (checkDepth && depth != 1)) {
+        lastError = "Invalid expression format";
+        return false;
+    }
+    
+    if (checkDepth) {
+        tree.emit(operands.back(), context.getStack().capacity(), compiled);
+    }
+    return true;
 }
 
-}
\ No newline at end of file
+}
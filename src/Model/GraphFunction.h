@@ -1,35 +1,119 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <functional>
 #include <vector>
 #include <memory>
+#include "BatchEvaluator.h"
+#include "EvaluationContext.h"
+#include "ExpressionTree.h"
 #include "GraphData.h"
+#include "InfixToRPN.h"
+#include "Program.h"
 
 class CalculatorModel;
 
 namespace RPN {
 
+class ExpressionCache;
+class ThreadPool;
+
+// Screen-space settings for EvaluateAdaptive. Pixel sizes are in plot
+// units; zero derives them from the range and the seed samples.
+struct SamplingOptions {
+    double xPixel = 0.0;
+    double yPixel = 0.0;
+    // Largest allowed gap, in pixels, between the curve at an
+    // interval's midpoint and the chord drawn across it.
+    double tolerance = 0.5;
+    size_t initialSamples = 129;
+    size_t maxSamples = 4096;
+};
+
 class GraphFunction {
 public:
+    // Sample counts from which Evaluate splits work across the thread pool.
+    static constexpr size_t PARALLEL_THRESHOLD = 4096;
+    static constexpr size_t PARALLEL_GRAIN = 2048;
+    
     GraphFunction(CalculatorModel* calculator);
+    // Uses a fixed set of user functions instead of following a calculator,
+    // so the function can be evaluated on another thread while the
+    // calculator changes. SetFunctions swaps in a newer table.
+    explicit GraphFunction(std::shared_ptr<const FunctionTable> functions);
+    void SetFunctions(std::shared_ptr<const FunctionTable> functions);
     
+    // Compiles the expression once; x becomes a variable slot in the program.
+    // Expressions compiled before against the same functions are taken
+    // from the expression cache.
     bool SetExpression(const std::string& expr);
     std::string GetExpression() const { return expression; }
+    // Changes whenever a user function is defined or redefined, so results
+    // cached under the expression text can be told apart.
+    uint64_t GetFunctionsVersion() const;
+    // The calculator's current functions, or the fixed table
+    std::shared_ptr<const FunctionTable> GetFunctions() const;
+    const Program& GetProgram() const { return program; }
     
+    // Large sample counts are evaluated in chunks on the thread pool, one
+    // cloned evaluator per worker.
     std::shared_ptr<GraphData> Evaluate(double xMin, double xMax, int numPoints = 1000);
     
+    // Starts from a coarse uniform grid and keeps halving intervals whose
+    // midpoint strays from the chord by more than the tolerance, or which
+    // straddle a pole or domain edge, until the budget runs out. Intervals
+    // narrower than a quarter pixel are left alone.
+    std::shared_ptr<GraphData> EvaluateAdaptive(double xMin, double xMax,
+                                                const SamplingOptions& options = SamplingOptions());
+    
+    // Bulk evaluation: y[i] = f(x[i]), NaN where the expression fails.
+    // Uses the SIMD batch evaluator when the program allows it, otherwise
+    // the interpreter.
+    void EvaluateBatch(const double* x, double* y, size_t count);
+    
+    // Pool used by Evaluate; nullptr selects ThreadPool::shared().
+    void SetThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+    // Cache SetExpression looks compiled expressions up in; nullptr
+    // selects ExpressionCache::Shared().
+    void SetExpressionCache(ExpressionCache* cache) { expressionCache = cache; }
+    
+    // Evaluates on this function's own context; the calculator's stack
+    // and error state are never touched.
     double EvaluateAtPoint(double x);
     
+    // Number of x values evaluated since construction or the last reset.
+    size_t GetEvaluationCount() const { return evaluationCount; }
+    void ResetEvaluationCount() { evaluationCount = 0; }
+    
     std::string GetLastError() const { return lastError; }
     bool HasError() const { return !lastError.empty(); }
 
 private:
     CalculatorModel* calculator;
+    // Used when there is no calculator
+    std::shared_ptr<const FunctionTable> pinnedFunctions;
+    ThreadPool* pool = nullptr;
+    ExpressionCache* expressionCache = nullptr;
+    EvaluationContext context;
+    BatchEvaluator batch;
+    std::shared_ptr<const FunctionTable> batchFunctions;
     std::string expression;
+    Program program;
     std::string lastError;
+    size_t evaluationCount = 0;
+    // Keep their buffers between compiles
+    InfixToRPN parser;
+    ExpressionTree tree;
+    std::vector<uint32_t> operands;
     
     bool IsValidExpression(const std::string& expr);
-    std::string PrepareExpression(const std::string& expr, double xValue);
+    bool Compile(const std::string& expr, const FunctionTable& functions, Program& compiled);
+    
+    // Picks up functions redefined since the last evaluation and rebuilds
+    // the batch program when they changed.
+    void RefreshFunctions();
+    void Sample(BatchEvaluator& evaluator, EvaluationContext& ctx,
+                const double* x, double* y, size_t count) const;
 };
 
-}
\ No newline at end of file
+}
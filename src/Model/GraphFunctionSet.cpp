@@ -0,0 +1,119 @@
+#include "GraphFunctionSet.h"
+#include "EvaluationContext.h"
+#include <cmath>
+#include <utility>
+
+namespace RPN {
+
+GraphFunctionSet::GraphFunctionSet(CalculatorModel* calculator)
+    : prototype(calculator) {}
+
+GraphFunctionSet::GraphFunctionSet(std::shared_ptr<const FunctionTable> functions)
+    : prototype(std::move(functions)) {}
+
+void GraphFunctionSet::SetFunctions(std::shared_ptr<const FunctionTable> functions) {
+    prototype.SetFunctions(functions);
+    for (auto& member : members) {
+        member.SetFunctions(functions);
+    }
+}
+
+bool GraphFunctionSet::SetExpressions(const std::vector<std::string>& expressions) {
+    if (expressions.size() > BatchEvaluator::MAX_PROGRAMS) {
+        lastError = "Too many expressions";
+        return false;
+    }
+
+    std::vector<GraphFunction> compiled(expressions.size(), prototype);
+    for (size_t k = 0; k < expressions.size(); ++k) {
+        if (!compiled[k].SetExpression(expressions[k])) {
+            lastError = expressions[k] + ": " + compiled[k].GetLastError();
+            return false;
+        }
+    }
+
+    members = std::move(compiled);
+    batchFunctions.reset();
+    RefreshFunctions();
+    lastError.clear();
+    return true;
+}
+
+std::vector<std::string> GraphFunctionSet::GetExpressions() const {
+    std::vector<std::string> expressions;
+    expressions.reserve(members.size());
+    for (const auto& member : members) {
+        expressions.push_back(member.GetExpression());
+    }
+    return expressions;
+}
+
+std::vector<std::shared_ptr<GraphData>> GraphFunctionSet::Evaluate(double xMin, double xMax, int numPoints) {
+    std::vector<std::shared_ptr<GraphData>> series;
+    if (members.empty() || numPoints < 2) {
+        return series;
+    }
+
+    size_t count = static_cast<size_t>(numPoints);
+    double step = (xMax - xMin) / (numPoints - 1);
+    std::vector<double> xValues(count);
+    for (size_t i = 0; i < count; ++i) {
+        xValues[i] = xMin + i * step;
+    }
+    std::vector<std::vector<double>> yValues(members.size(), std::vector<double>(count));
+    std::vector<double*> outputs;
+    for (auto& y : yValues) {
+        outputs.push_back(y.data());
+    }
+    EvaluateBatch(xValues.data(), outputs.data(), count);
+
+    for (size_t k = 0; k < members.size(); ++k) {
+        std::vector<double> xs, ys;
+        xs.reserve(count);
+        ys.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (std::isfinite(yValues[k][i])) {
+                xs.push_back(xValues[i]);
+                ys.push_back(yValues[k][i]);
+            }
+        }
+        auto data = std::make_shared<GraphData>();
+        data->SetData(std::move(xs), std::move(ys));
+        data->SetLabel(members[k].GetExpression());
+        series.push_back(std::move(data));
+    }
+    return series;
+}
+
+void GraphFunctionSet::EvaluateBatch(const double* x, double* const* y, size_t count) {
+    if (members.empty()) {
+        return;
+    }
+
+    RefreshFunctions();
+    if (batch.isCompiled()) {
+        batch.evaluate(x, y, count);
+    }
+    for (size_t k = 0; k < members.size(); ++k) {
+        if (!batch.isCompiled(k)) {
+            members[k].EvaluateBatch(x, y[k], count);
+        }
+    }
+    evaluationCount += count * members.size();
+}
+
+void GraphFunctionSet::RefreshFunctions() {
+    auto snapshot = prototype.GetFunctions();
+    if (snapshot == batchFunctions) {
+        return;
+    }
+
+    std::vector<const Program*> programs;
+    for (const auto& member : members) {
+        programs.push_back(&member.GetProgram());
+    }
+    batch.compile(programs, *snapshot, EvaluationContext::DEFAULT_STACK_CAPACITY);
+    batchFunctions = std::move(snapshot);
+}
+
+}
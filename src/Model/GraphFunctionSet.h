@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BatchEvaluator.h"
+#include "FunctionTable.h"
+#include "GraphData.h"
+#include "GraphFunction.h"
+
+class CalculatorModel;
+
+namespace RPN {
+
+// Several expressions sampled together over one x grid. Their programs are
+// compiled into a single BatchEvaluator, so each block of x values is set
+// up once for all of them and subexpressions the curves have in common
+// are computed once per sample. Expressions the batch evaluator rejects
+// are sampled by their own GraphFunction.
+class GraphFunctionSet {
+public:
+    explicit GraphFunctionSet(CalculatorModel* calculator);
+    // Fixed functions, as for GraphFunction, so the set can be sampled on
+    // another thread
+    explicit GraphFunctionSet(std::shared_ptr<const FunctionTable> functions);
+    void SetFunctions(std::shared_ptr<const FunctionTable> functions);
+
+    // Replaces all expressions. If any of them fails to compile the set
+    // is left unchanged and the error names the expression.
+    bool SetExpressions(const std::vector<std::string>& expressions);
+    std::vector<std::string> GetExpressions() const;
+    size_t GetSize() const { return members.size(); }
+    uint64_t GetFunctionsVersion() const { return prototype.GetFunctionsVersion(); }
+
+    // One series per expression over a shared grid of numPoints samples,
+    // with non-finite samples left out as in GraphFunction::Evaluate.
+    std::vector<std::shared_ptr<GraphData>> Evaluate(double xMin, double xMax, int numPoints = 1000);
+
+    // y[k][i] = expression k at x[i], NaN where it fails.
+    void EvaluateBatch(const double* x, double* const* y, size_t count);
+
+    // Operations the shared batch program runs per block, after common
+    // subexpressions are merged
+    size_t GetOperationCount() const { return batch.operationCount(); }
+
+    // Samples evaluated, counting each expression separately.
+    size_t GetEvaluationCount() const { return evaluationCount; }
+    void ResetEvaluationCount() { evaluationCount = 0; }
+
+    std::string GetLastError() const { return lastError; }
+
+private:
+    // Unset function that new members are copied from
+    GraphFunction prototype;
+    std::vector<GraphFunction> members;
+    BatchEvaluator batch;
+    std::shared_ptr<const FunctionTable> batchFunctions;
+    size_t evaluationCount = 0;
+    std::string lastError;
+
+    // Recompiles the shared program when the functions have changed.
+    void RefreshFunctions();
+};
+
+}
@@ -0,0 +1,188 @@
+#include "GraphTileCache.h"
+#include "GraphFunction.h"
+#include "GraphFunctionSet.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+namespace RPN {
+
+namespace {
+
+// Tiles further out than this from zero are not addressable; their x
+// values would no longer be exact multiples of the spacing
+constexpr double MAX_TILE_INDEX = 4503599627370496.0 / GraphTileCache::TILE_SAMPLES;  // 2^52
+
+// Visible ranges needing more tiles than this are refused rather than
+// evaluated; it is far beyond any plot width
+constexpr double MAX_TILES = 4096.0;
+
+}
+
+size_t GraphTileCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<std::string>()(key.expression);
+    hash = hash * 31 + std::hash<uint64_t>()(key.functionsVersion);
+    hash = hash * 31 + std::hash<int>()(key.level);
+    hash = hash * 31 + std::hash<int64_t>()(key.index);
+    return hash;
+}
+
+GraphTileCache::GraphTileCache(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1)) {
+}
+
+std::shared_ptr<GraphData> GraphTileCache::Sample(GraphFunction& function, double xMin, double xMax,
+                                                  double xPixel, const std::atomic<bool>* cancel) {
+    if (function.GetExpression().empty()) {
+        auto data = std::make_shared<GraphData>();
+        data->SetLabel(function.GetExpression());
+        return data;
+    }
+    auto evaluate = [&function](const double* x, double* const* y, size_t count) {
+        function.EvaluateBatch(x, y[0], count);
+    };
+    std::vector<std::shared_ptr<GraphData>> series;
+    if (!SampleTiles({function.GetExpression()}, function.GetFunctionsVersion(),
+                     xMin, xMax, xPixel, cancel, evaluate, series)) {
+        return nullptr;
+    }
+    return series[0];
+}
+
+std::vector<std::shared_ptr<GraphData>> GraphTileCache::Sample(GraphFunctionSet& functions, double xMin,
+                                                               double xMax, double xPixel,
+                                                               const std::atomic<bool>* cancel) {
+    auto evaluate = [&functions](const double* x, double* const* y, size_t count) {
+        functions.EvaluateBatch(x, y, count);
+    };
+    std::vector<std::shared_ptr<GraphData>> series;
+    if (!SampleTiles(functions.GetExpressions(), functions.GetFunctionsVersion(),
+                     xMin, xMax, xPixel, cancel, evaluate, series)) {
+        series.clear();
+    }
+    return series;
+}
+
+void GraphTileCache::Clear() {
+    tiles.clear();
+    lookup.clear();
+}
+
+bool GraphTileCache::SampleTiles(const std::vector<std::string>& expressions, uint64_t functionsVersion,
+                                 double xMin, double xMax, double xPixel, const std::atomic<bool>* cancel,
+                                 const Evaluator& evaluate, std::vector<std::shared_ptr<GraphData>>& series) {
+    series.clear();
+    for (const auto& expression : expressions) {
+        series.push_back(std::make_shared<GraphData>());
+        series.back()->SetLabel(expression);
+    }
+    if (expressions.empty() || !(xMin < xMax) || !(xPixel > 0.0) ||
+        !std::isfinite(xMax - xMin) || !std::isfinite(xPixel)) {
+        return true;
+    }
+
+    // ilogb is floor(log2) for normal numbers, so the spacing is at most
+    // one pixel and at least half of one
+    int level = std::ilogb(xPixel);
+    double spacing = std::ldexp(1.0, level);
+    double tileWidth = spacing * TILE_SAMPLES;
+    double first = std::floor(xMin / tileWidth);
+    double last = std::floor(xMax / tileWidth);
+    if (std::fabs(first) > MAX_TILE_INDEX || std::fabs(last) > MAX_TILE_INDEX ||
+        last - first >= MAX_TILES) {
+        return true;
+    }
+
+    size_t tileCount = static_cast<size_t>(last - first) + 1;
+    std::vector<std::vector<double>> xs(expressions.size()), ys(expressions.size());
+    for (size_t k = 0; k < expressions.size(); ++k) {
+        xs[k].reserve(tileCount * TILE_SAMPLES);
+        ys[k].reserve(tileCount * TILE_SAMPLES);
+    }
+
+    std::vector<double> tileX(TILE_SAMPLES);
+    std::vector<std::vector<double>> fresh(expressions.size(), std::vector<double>(TILE_SAMPLES));
+    std::vector<double*> freshOutputs;
+    for (auto& y : fresh) {
+        freshOutputs.push_back(y.data());
+    }
+    std::vector<Key> keys;
+    for (const auto& expression : expressions) {
+        keys.push_back({expression, functionsVersion, level, 0});
+    }
+    std::vector<std::list<Tile>::iterator> found(expressions.size());
+
+    for (int64_t index = static_cast<int64_t>(first); index <= static_cast<int64_t>(last); ++index) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        for (size_t i = 0; i < TILE_SAMPLES; ++i) {
+            tileX[i] = static_cast<double>(index * static_cast<int64_t>(TILE_SAMPLES) +
+                                           static_cast<int64_t>(i)) * spacing;
+        }
+
+        // A tile missing for any expression is evaluated for all of them,
+        // so the set still shares one pass over the grid
+        for (auto& key : keys) {
+            key.index = index;
+        }
+        bool complete = true;
+        for (size_t k = 0; k < keys.size(); ++k) {
+            auto it = lookup.find(keys[k]);
+            if (it == lookup.end()) {
+                complete = false;
+                break;
+            }
+            found[k] = it->second;
+        }
+        if (complete) {
+            hits += keys.size();
+            for (size_t k = 0; k < keys.size(); ++k) {
+                tiles.splice(tiles.begin(), tiles, found[k]);
+                Append(tileX, found[k]->ys, xs[k], ys[k]);
+            }
+            continue;
+        }
+
+        misses += keys.size();
+        evaluate(tileX.data(), freshOutputs.data(), TILE_SAMPLES);
+        for (size_t k = 0; k < keys.size(); ++k) {
+            Append(tileX, fresh[k], xs[k], ys[k]);
+            Store(keys[k], fresh[k]);
+        }
+    }
+
+    for (size_t k = 0; k < expressions.size(); ++k) {
+        series[k]->SetData(std::move(xs[k]), std::move(ys[k]));
+    }
+    return true;
+}
+
+void GraphTileCache::Append(const std::vector<double>& tileX, const std::vector<double>& tileY,
+                            std::vector<double>& xs, std::vector<double>& ys) {
+    for (size_t i = 0; i < TILE_SAMPLES; ++i) {
+        if (std::isfinite(tileY[i])) {
+            xs.push_back(tileX[i]);
+            ys.push_back(tileY[i]);
+        }
+    }
+}
+
+void GraphTileCache::Store(const Key& key, const std::vector<double>& ys) {
+    auto found = lookup.find(key);
+    if (found != lookup.end()) {
+        found->second->ys = ys;
+        tiles.splice(tiles.begin(), tiles, found->second);
+        return;
+    }
+
+    if (tiles.size() >= capacity) {
+        lookup.erase(tiles.back().key);
+        tiles.pop_back();
+    }
+    tiles.push_front(Tile{key, ys});
+    lookup.emplace(key, tiles.begin());
+}
+
+}
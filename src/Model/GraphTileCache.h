@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GraphData.h"
+
+namespace RPN {
+
+class GraphFunction;
+class GraphFunctionSet;
+
+// Samples of an expression over the visible x range, kept as fixed tiles so
+// panning and zooming only evaluate the part of the range not seen before.
+//
+// Samples sit on a power-of-two grid: the spacing is the largest 2^k not
+// above the pixel width, and tile i at that spacing holds the TILE_SAMPLES
+// samples starting at i * TILE_SAMPLES * 2^k. Tiles are keyed by expression,
+// function table version, spacing and index, and the least recently used
+// ones are dropped once the cache holds more than its capacity.
+class GraphTileCache {
+public:
+    static constexpr size_t TILE_SAMPLES = 256;
+
+    explicit GraphTileCache(size_t capacity = 512);
+
+    // Samples the function's current expression over every tile that
+    // touches [xMin, xMax], fetching cached tiles and evaluating the rest.
+    // Non-finite samples are left out, as in GraphFunction::Evaluate.
+    // Once *cancel is set the remaining tiles are skipped and nullptr is
+    // returned; tiles already evaluated stay cached.
+    std::shared_ptr<GraphData> Sample(GraphFunction& function, double xMin, double xMax,
+                                      double xPixel, const std::atomic<bool>* cancel = nullptr);
+    // One series per expression of the set, on the same tiles. A tile
+    // missing for any expression is evaluated for the whole set in one
+    // pass. Cancelling returns an empty vector.
+    std::vector<std::shared_ptr<GraphData>> Sample(GraphFunctionSet& functions, double xMin, double xMax,
+                                                   double xPixel,
+                                                   const std::atomic<bool>* cancel = nullptr);
+
+    void Clear();
+
+    size_t GetSize() const { return tiles.size(); }
+    size_t GetCapacity() const { return capacity; }
+    // Tiles served from the cache and tiles evaluated, since construction
+    size_t GetHits() const { return hits; }
+    size_t GetMisses() const { return misses; }
+
+private:
+    struct Key {
+        std::string expression;
+        uint64_t functionsVersion;
+        int level;
+        int64_t index;
+
+        bool operator==(const Key& other) const {
+            return level == other.level && index == other.index &&
+                   functionsVersion == other.functionsVersion &&
+                   expression == other.expression;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Tile {
+        Key key;
+        std::vector<double> ys;
+    };
+
+    // Most recently used first
+    std::list<Tile> tiles;
+    std::unordered_map<Key, std::list<Tile>::iterator, KeyHash> lookup;
+    size_t capacity;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    // y[k] receives expression k's samples at x
+    using Evaluator = std::function<void(const double* x, double* const* y, size_t count)>;
+
+    // Fills one series per expression; false if cancelled.
+    bool SampleTiles(const std::vector<std::string>& expressions, uint64_t functionsVersion,
+                     double xMin, double xMax, double xPixel, const std::atomic<bool>* cancel,
+                     const Evaluator& evaluate, std::vector<std::shared_ptr<GraphData>>& series);
+    // Appends a tile's finite samples
+    static void Append(const std::vector<double>& tileX, const std::vector<double>& tileY,
+                       std::vector<double>& xs, std::vector<double>& ys);
+    void Store(const Key& key, const std::vector<double>& ys);
+};
+
+}
@@ -1,115 +1,241 @@
 #include "InfixToRPN.h"
-#include <stack>
-#include <sstream>
-#include <regex>
+#include "NumberLexer.h"
 #include <cctype>
 
 namespace RPN {
 
-std::vector<std::string> InfixToRPN::convert(const std::string& infix) {
-    std::vector<std::string> tokens = tokenize(infix);
-    std::vector<std::string> output;
-    std::stack<std::string> operators;
-    
-    for (const auto& token : tokens) {
-        if (isNumber(token)) {
-            output.push_back(token);
-        } else if (isFunction(token)) {
-            operators.push(token);
-        } else if (token == "(") {
-            operators.push(token);
-        } else if (token == ")") {
-            while (!operators.empty() && operators.top() != "(") {
-                output.push_back(operators.top());
-                operators.pop();
-            }
-            if (!operators.empty()) {
-                operators.pop();
-                if (!operators.empty() && isFunction(operators.top())) {
-                    output.push_back(operators.top());
-                    operators.pop();
-                }
-            }
-        } else if (isOperator(token)) {
-            while (!operators.empty() && 
-                   operators.top() != "(" &&
-                   getPrecedence(operators.top()) >= getPrecedence(token)) {
-                output.push_back(operators.top());
-                operators.pop();
-            }
-            operators.push(token);
+namespace {
+
+using Token = InfixToRPN::Token;
+using TokenKind = InfixToRPN::TokenKind;
+
+struct OperatorInfo {
+    char symbol;
+    Builtin op;
+    int precedence;
+};
+
+// Binary operators, all left-associative. Unary minus sits between * and
+// ^, so -x^2 is -(x^2) and -x*2 is (-x)*2.
+constexpr OperatorInfo operatorTable[] = {
+    {'+', Builtin::Add, 1},
+    {'-', Builtin::Subtract, 1},
+    {'*', Builtin::Multiply, 2},
+    {'/', Builtin::Divide, 2},
+    {'%', Builtin::Mod, 2},
+    {'^', Builtin::Power, 4},
+};
+
+constexpr int NEGATE_PRECEDENCE = 3;
+
+// Builtins that may also be applied without parentheses, as in "sqrt x"
+constexpr std::string_view prefixFunctions[] = {
+    "sin", "cos", "tan", "ln", "log", "sqrt", "abs", "exp",
+};
+
+const OperatorInfo* findOperator(char ch) {
+    for (const auto& info : operatorTable) {
+        if (info.symbol == ch) {
+            return &info;
         }
     }
-    
-    while (!operators.empty()) {
-        output.push_back(operators.top());
-        operators.pop();
-    }
-    
-    return output;
+    return nullptr;
 }
 
-int InfixToRPN::getPrecedence(const std::string& op) {
-    if (op == "+" || op == "-") return 1;
-    if (op == "*" || op == "/" || op == "%") return 2;
-    if (op == "^") return 3;
+int getPrecedence(Builtin op) {
+    if (op == Builtin::Negate) {
+        return NEGATE_PRECEDENCE;
+    }
+    for (const auto& info : operatorTable) {
+        if (info.op == op) {
+            return info.precedence;
+        }
+    }
     return 0;
 }
 
-bool InfixToRPN::isOperator(const std::string& token) {
-    return token == "+" || token == "-" || token == "*" || 
-           token == "/" || token == "%" || token == "^";
+bool isPrefixFunction(std::string_view word) {
+    for (auto name : prefixFunctions) {
+        if (name == word) {
+            return true;
+        }
+    }
+    return false;
 }
 
-bool InfixToRPN::isFunction(const std::string& token) {
-    return token == "sin" || token == "cos" || token == "tan" ||
-           token == "ln" || token == "log" || token == "sqrt" ||
-           token == "abs" || token == "exp";
+bool isSpace(char ch) {
+    return std::isspace(static_cast<unsigned char>(ch)) != 0;
 }
 
-bool InfixToRPN::isNumber(const std::string& token) {
-    try {
-        std::stod(token);
-        return true;
-    } catch (...) {
-        return false;
-    }
+bool isDelimiter(char ch) {
+    return isSpace(ch) || ch == '(' || ch == ')' || findOperator(ch) != nullptr;
 }
 
-std::vector<std::string> InfixToRPN::tokenize(const std::string& expression) {
-    std::vector<std::string> tokens;
-    std::string current;
-    
-    for (size_t i = 0; i < expression.length(); ++i) {
-        char ch = expression[i];
-        
-        if (std::isspace(ch)) {
-            if (!current.empty()) {
-                tokens.push_back(current);
-                current.clear();
+// Splits the input into tokens in one pass. A word runs to the next space,
+// parenthesis or operator, except that a numeric word keeps the sign of
+// its exponent ("1e-5", "0x1p-3").
+class Lexer {
+public:
+    explicit Lexer(std::string_view text) : text(text) {}
+
+    // Reads the next token, false at the end of the input. expectOperand
+    // tells whether a sign here is unary; unary plus is skipped.
+    bool next(bool expectOperand, Token& token) {
+        for (;;) {
+            while (pos < text.size() && isSpace(text[pos])) {
+                ++pos;
             }
-        } else if (ch == '(' || ch == ')') {
-            if (!current.empty()) {
-                tokens.push_back(current);
-                current.clear();
+            if (pos == text.size()) {
+                return false;
             }
-            tokens.push_back(std::string(1, ch));
-        } else if (isOperator(std::string(1, ch))) {
-            if (!current.empty()) {
-                tokens.push_back(current);
-                current.clear();
+
+            size_t start = pos;
+            char ch = text[pos];
+            if (ch == '(' || ch == ')') {
+                ++pos;
+                TokenKind kind = ch == '(' ? TokenKind::LEFT_PAREN : TokenKind::RIGHT_PAREN;
+                token = {kind, Builtin::Count, text.substr(start, 1), 0.0};
+                return true;
             }
-            tokens.push_back(std::string(1, ch));
-        } else {
-            current += ch;
+            if (const OperatorInfo* info = findOperator(ch)) {
+                ++pos;
+                if (expectOperand && info->op == Builtin::Add) {
+                    continue;
+                }
+                Builtin op = expectOperand && info->op == Builtin::Subtract ? Builtin::Negate : info->op;
+                token = {TokenKind::OPERATOR, op, text.substr(start, 1), 0.0};
+                return true;
+            }
+
+            pos = scanWord(start);
+            std::string_view word = text.substr(start, pos - start);
+            double value = 0.0;
+            if (parseNumber(word, value)) {
+                token = {TokenKind::NUMBER, Builtin::Count, word, value};
+            } else if (isPrefixFunction(word) || nextIs('(')) {
+                token = {TokenKind::FUNCTION, Builtin::Count, word, 0.0};
+            } else {
+                token = {TokenKind::IDENTIFIER, Builtin::Count, word, 0.0};
+            }
+            return true;
         }
     }
-    
-    if (!current.empty()) {
-        tokens.push_back(current);
+
+private:
+    std::string_view text;
+    size_t pos = 0;
+
+    size_t scanWord(size_t start) const {
+        char first = text[start];
+        bool numeric = std::isdigit(static_cast<unsigned char>(first)) || first == '.';
+        bool hex = numeric && text.size() > start + 1 && first == '0' &&
+                   (text[start + 1] == 'x' || text[start + 1] == 'X');
+        char exponent = hex ? 'p' : 'e';
+
+        size_t end = start;
+        while (end < text.size()) {
+            char ch = text[end];
+            bool exponentSign = numeric && end > start && (ch == '+' || ch == '-') &&
+                                std::tolower(static_cast<unsigned char>(text[end - 1])) == exponent;
+            if (!exponentSign && isDelimiter(ch)) {
+                break;
+            }
+            ++end;
+        }
+        return end;
     }
-    
-    return tokens;
+
+    bool nextIs(char ch) const {
+        size_t i = pos;
+        while (i < text.size() && isSpace(text[i])) {
+            ++i;
+        }
+        return i < text.size() && text[i] == ch;
+    }
+};
+
+}
+
+bool InfixToRPN::parse(std::string_view infix) {
+    output.clear();
+    operators.clear();
+
+    Lexer lexer(infix);
+    Token token;
+    bool expectOperand = true;
+
+    while (lexer.next(expectOperand, token)) {
+        switch (token.kind) {
+            case TokenKind::NUMBER:
+            case TokenKind::IDENTIFIER:
+                output.push_back(token);
+                expectOperand = false;
+                break;
+
+            case TokenKind::FUNCTION:
+            case TokenKind::LEFT_PAREN:
+                operators.push_back(token);
+                expectOperand = true;
+                break;
+
+            case TokenKind::RIGHT_PAREN:
+                while (!operators.empty() && operators.back().kind != TokenKind::LEFT_PAREN) {
+                    output.push_back(operators.back());
+                    operators.pop_back();
+                }
+                if (operators.empty()) {
+                    return false;
+                }
+                operators.pop_back();
+                if (!operators.empty() && operators.back().kind == TokenKind::FUNCTION) {
+                    output.push_back(operators.back());
+                    operators.pop_back();
+                }
+                expectOperand = false;
+                break;
+
+            case TokenKind::OPERATOR:
+                // A prefix operator has no left operand to finish first
+                if (token.op != Builtin::Negate) {
+                    int precedence = getPrecedence(token.op);
+                    while (!operators.empty() && operators.back().kind == TokenKind::OPERATOR &&
+                           getPrecedence(operators.back().op) >= precedence) {
+                        output.push_back(operators.back());
+                        operators.pop_back();
+                    }
+                }
+                operators.push_back(token);
+                expectOperand = true;
+                break;
+        }
+    }
+
+    while (!operators.empty()) {
+        if (operators.back().kind == TokenKind::LEFT_PAREN) {
+            return false;
+        }
+        output.push_back(operators.back());
+        operators.pop_back();
+    }
+    return true;
 }
 
-}
\ No newline at end of file
+std::vector<std::string> InfixToRPN::convert(const std::string& infix) {
+    InfixToRPN converter;
+    std::vector<std::string> result;
+    if (!converter.parse(infix)) {
+        return result;
+    }
+
+    result.reserve(converter.tokens().size());
+    for (const Token& token : converter.tokens()) {
+        if (token.kind == TokenKind::OPERATOR && token.op == Builtin::Negate) {
+            result.emplace_back(builtinName(Builtin::Negate));
+        } else {
+            result.emplace_back(token.text);
+        }
+    }
+    return result;
+}
+
+}
@@ -1,23 +1,50 @@
 #ifndef INFIX_TO_RPN_H
 #define INFIX_TO_RPN_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "Builtins.h"
 
 namespace RPN {
 
+// Shunting-yard conversion from infix to RPN. A single-pass lexer over a
+// string_view produces small tokens that point back into the input, and
+// the operator stack and output are kept between calls, so once they have
+// grown to fit, converting an expression allocates nothing.
 class InfixToRPN {
 public:
+    enum class TokenKind : uint8_t {
+        NUMBER,      // value holds the literal
+        IDENTIFIER,  // an operand such as x
+        FUNCTION,    // a name followed by "(", or a builtin function name
+        OPERATOR,    // op holds the builtin; unary minus is Builtin::Negate
+        LEFT_PAREN,
+        RIGHT_PAREN
+    };
+
+    struct Token {
+        TokenKind kind;
+        Builtin op;
+        std::string_view text;
+        double value;
+    };
+
+    // Converts infix into tokens(), in RPN order. The tokens view infix,
+    // which must outlive them. Returns false on unbalanced parentheses.
+    bool parse(std::string_view infix);
+    const std::vector<Token>& tokens() const { return output; }
+
+    // One string per RPN token, or none if the parentheses are unbalanced.
+    // Unary minus is written "+/-".
     static std::vector<std::string> convert(const std::string& infix);
-    
+
 private:
-    static int getPrecedence(const std::string& op);
-    static bool isOperator(const std::string& token);
-    static bool isFunction(const std::string& token);
-    static bool isNumber(const std::string& token);
-    static std::vector<std::string> tokenize(const std::string& expression);
+    std::vector<Token> output;
+    std::vector<Token> operators;
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
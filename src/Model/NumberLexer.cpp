@@ -0,0 +1,44 @@
+#include "NumberLexer.h"
+#include <charconv>
+#include <system_error>
+
+namespace RPN {
+
+bool parseNumber(std::string_view text, double& value) {
+    const char* first = text.data();
+    const char* last = first + text.size();
+    if (first == last) {
+        return false;
+    }
+
+    // from_chars handles '-' itself but rejects '+' and any base prefix.
+    bool negative = false;
+    if (*first == '+' || *first == '-') {
+        negative = (*first == '-');
+        ++first;
+    }
+    if (first == last || *first == '+' || *first == '-') {
+        return false;
+    }
+
+    std::chars_format format = std::chars_format::general;
+    if (last - first > 2 && first[0] == '0' && (first[1] == 'x' || first[1] == 'X')) {
+        format = std::chars_format::hex;
+        first += 2;
+        // The sign goes before the prefix; "0x-1" is not a number
+        if (*first == '+' || *first == '-') {
+            return false;
+        }
+    }
+
+    double parsed;
+    auto result = std::from_chars(first, last, parsed, format);
+    if (result.ec != std::errc() || result.ptr != last) {
+        return false;
+    }
+
+    value = negative ? -parsed : parsed;
+    return true;
+}
+
+}
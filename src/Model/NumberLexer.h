@@ -0,0 +1,18 @@
+#ifndef NUMBER_LEXER_H
+#define NUMBER_LEXER_H
+
+#include <string_view>
+
+namespace RPN {
+
+// Parses the whole of text as a numeric literal without allocating or
+// throwing. Accepts an optional sign followed by a decimal number with
+// optional fraction and exponent ("-1.5e3"), a hex integer or hex float
+// ("0xff", "0x1.8p1"), or a special value ("inf", "infinity", "nan").
+// Returns false, leaving value untouched, if text is not exactly one
+// literal or the value is out of range.
+bool parseNumber(std::string_view text, double& value);
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "PlotWorker.h"
+#include <utility>
+
+namespace RPN {
+
+PlotWorker::PlotWorker() {
+    thread = std::thread([this] { Run(); });
+}
+
+PlotWorker::~PlotWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        cancelled.store(true, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+uint64_t PlotWorker::Submit(Request request) {
+    uint64_t job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = ++submitted;
+        pending = std::move(request);
+        hasPending = true;
+        hasResult = false;
+        cancelled.store(true, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+    return job;
+}
+
+void PlotWorker::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++submitted;
+    hasPending = false;
+    hasResult = false;
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+bool PlotWorker::TakeResult(Result& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hasResult) {
+        return false;
+    }
+    result = std::move(published);
+    hasResult = false;
+    return true;
+}
+
+bool PlotWorker::IsBusy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hasPending || running;
+}
+
+void PlotWorker::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return hasPending || stopping; });
+        if (stopping) {
+            return;
+        }
+
+        Request request = std::move(pending);
+        uint64_t job = submitted;
+        hasPending = false;
+        running = true;
+        cancelled.store(false, std::memory_order_relaxed);
+
+        lock.unlock();
+        Process(request, job);
+        lock.lock();
+        running = false;
+    }
+}
+
+void PlotWorker::Process(const Request& request, uint64_t job) {
+    Result result;
+    result.job = job;
+
+    // Recompile only when the expressions or the functions they may call
+    // have changed since the last job
+    bool sameExpressions = request.expressions == functions.GetExpressions();
+    bool sameFunctions = request.functions->getVersion() == functions.GetFunctionsVersion();
+    functions.SetFunctions(request.functions);
+    if (!sameExpressions) {
+        functions.ResetEvaluationCount();
+    }
+    if ((!sameExpressions || !sameFunctions) && !functions.SetExpressions(request.expressions)) {
+        result.final = true;
+        result.error = functions.GetLastError();
+        Publish(std::move(result));
+        return;
+    }
+
+    double xPixel = (request.xMax - request.xMin) / static_cast<double>(request.pixels ? request.pixels : 1);
+    for (double factor : {COARSE_FACTOR, 1.0}) {
+        auto series = cache.Sample(functions, request.xMin, request.xMax, xPixel * factor, &cancelled);
+        if (series.size() != request.expressions.size()) {
+            return;
+        }
+        result.series = std::move(series);
+        result.final = factor == 1.0;
+        result.evaluationCount = functions.GetEvaluationCount();
+        Publish(result);
+    }
+}
+
+void PlotWorker::Publish(Result result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (result.job != submitted) {
+        return;
+    }
+    published = std::move(result);
+    hasResult = true;
+}
+
+}
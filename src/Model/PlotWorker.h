@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FunctionTable.h"
+#include "GraphData.h"
+#include "GraphFunctionSet.h"
+#include "GraphTileCache.h"
+
+namespace RPN {
+
+// Samples expressions on a background thread so the UI thread never
+// waits for evaluation. A job plots a list of expressions together over
+// a shared grid (see GraphFunctionSet), through a tile cache, in two
+// passes: first with samples COARSE_FACTOR pixels apart, then at full
+// resolution. Every pass is published as finished series for the UI to
+// pick up with TakeResult at the start of a frame. Submitting a new
+// job cancels the one in flight at the next tile boundary.
+class PlotWorker {
+public:
+    static constexpr double COARSE_FACTOR = 8.0;
+
+    struct Request {
+        std::vector<std::string> expressions;
+        // Snapshot taken on the submitting thread; the worker never
+        // touches the calculator
+        std::shared_ptr<const FunctionTable> functions;
+        double xMin = 0.0;
+        double xMax = 0.0;
+        size_t pixels = 0;
+    };
+
+    struct Result {
+        uint64_t job = 0;
+        // One series per expression, in request order
+        std::vector<std::shared_ptr<GraphData>> series;
+        // Set on the full-resolution pass, or with error
+        bool final = false;
+        std::string error;
+        // Samples evaluated for these expressions since they were first
+        // submitted, counting each expression separately
+        size_t evaluationCount = 0;
+    };
+
+    PlotWorker();
+    ~PlotWorker();
+
+    PlotWorker(const PlotWorker&) = delete;
+    PlotWorker& operator=(const PlotWorker&) = delete;
+
+    // Queues the request in place of any pending one, cancels the job in
+    // flight and returns the new job's number.
+    uint64_t Submit(Request request);
+    // Drops the pending request, the job in flight and any unread result.
+    void Cancel();
+
+    // Moves the newest result published since the last call into result.
+    // Results of superseded jobs are never returned.
+    bool TakeResult(Result& result);
+    // True from Submit until the job's final result is published.
+    bool IsBusy() const;
+
+private:
+    // Owned by the worker thread
+    GraphFunctionSet functions{std::make_shared<const FunctionTable>()};
+    GraphTileCache cache;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    Request pending;
+    bool hasPending = false;
+    bool running = false;
+    bool stopping = false;
+    uint64_t submitted = 0;
+    Result published;
+    bool hasResult = false;
+    std::atomic<bool> cancelled{false};
+
+    void Run();
+    void Process(const Request& request, uint64_t job);
+    // Publishes unless the job has been superseded.
+    void Publish(Result result);
+};
+
+}
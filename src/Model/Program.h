@@ -0,0 +1,36 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <cstdint>
+#include <vector>
+
+namespace RPN {
+
+// Compiled form shared by user function bodies and graph expressions:
+// literals are pre-parsed, builtins and calls resolved to indices, so
+// execution does no string work.
+enum class OpCode : uint8_t {
+    PUSH,
+    LOAD_X,
+    BUILTIN,
+    CALL,
+    // Pushes a copy of the value index places below the top, so 0 copies
+    // the top. Only the compiler emits it, to reuse computed values.
+    COPY,
+    // Fused forms of "dup *" and "* value +" from the function body
+    // optimizer (ProgramOptimizer.h), rounded like the separate operations
+    SQUARE,
+    MULTIPLY_ADD
+};
+
+struct Instruction {
+    OpCode code;
+    uint32_t index;
+    double value;
+};
+
+using Program = std::vector<Instruction>;
+
+}
+
+#endif
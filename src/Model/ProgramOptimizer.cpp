@@ -0,0 +1,217 @@
+#include "ProgramOptimizer.h"
+#include "Builtins.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace RPN {
+
+namespace {
+
+bool isBuiltin(const Instruction& instruction, Builtin op) {
+    return instruction.code == OpCode::BUILTIN && instruction.index == static_cast<uint32_t>(op);
+}
+
+bool isPush(const Instruction& instruction) {
+    return instruction.code == OpCode::PUSH;
+}
+
+Instruction push(double value) {
+    return {OpCode::PUSH, 0, value};
+}
+
+// Values an instruction needs on the stack, and the change in depth after
+// it runs. Pick and roll need at least two values whatever their operand.
+void stackEffect(const Instruction& instruction, int64_t& needs, int64_t& change) {
+    switch (instruction.code) {
+        case OpCode::PUSH:
+        case OpCode::LOAD_X:
+            needs = 0;
+            change = 1;
+            return;
+        case OpCode::COPY:
+            needs = static_cast<int64_t>(instruction.index) + 1;
+            change = 1;
+            return;
+        case OpCode::SQUARE:
+            needs = 1;
+            change = 0;
+            return;
+        case OpCode::MULTIPLY_ADD:
+            needs = 2;
+            change = -1;
+            return;
+        case OpCode::CALL:
+            needs = 0;
+            change = 0;
+            return;
+        case OpCode::BUILTIN:
+            break;
+    }
+
+    Builtin op = static_cast<Builtin>(instruction.index);
+    switch (builtinArity(op)) {
+        case Arity::UNARY: needs = 1; change = 0; return;
+        case Arity::BINARY: needs = 2; change = -1; return;
+        case Arity::STACK: break;
+    }
+    switch (op) {
+        case Builtin::Dup: needs = 1; change = 1; return;
+        case Builtin::Drop: needs = 1; change = -1; return;
+        case Builtin::Rot: needs = 3; change = 0; return;
+        case Builtin::Over: needs = 2; change = 1; return;
+        case Builtin::Roll: needs = 2; change = -1; return;
+        default: needs = 2; change = 0; return;
+    }
+}
+
+// Stack depth each run between calls needs on entry to complete. A call's
+// effect is unknown, so the depth is counted again after it.
+std::vector<int64_t> requiredDepths(const Program& program) {
+    std::vector<int64_t> depths(1, 0);
+    int64_t height = 0;
+    for (const Instruction& instruction : program) {
+        if (instruction.code == OpCode::CALL) {
+            depths.push_back(0);
+            height = 0;
+            continue;
+        }
+        int64_t needs;
+        int64_t change;
+        stackEffect(instruction, needs, change);
+        depths.back() = std::max(depths.back(), needs - height);
+        height += change;
+    }
+    return depths;
+}
+
+// Rewrites the end of the program after an instruction has been appended;
+// false once nothing more applies.
+bool simplifyTail(Program& code, bool dropShuffles) {
+    size_t n = code.size();
+    if (n < 2 || code[n - 1].code != OpCode::BUILTIN) {
+        return false;
+    }
+    Builtin op = static_cast<Builtin>(code[n - 1].index);
+    Instruction& previous = code[n - 2];
+    double result;
+
+    switch (builtinArity(op)) {
+        case Arity::UNARY:
+            if (isPush(previous) && !applyUnary(op, previous.value, result)) {
+                code.resize(n - 2);
+                code.push_back(push(result));
+                return true;
+            }
+            return false;
+
+        case Arity::BINARY:
+            if (n >= 3 && isPush(code[n - 3]) && isPush(previous) &&
+                !applyBinary(op, code[n - 3].value, previous.value, result)) {
+                code.resize(n - 3);
+                code.push_back(push(result));
+                return true;
+            }
+            if (op == Builtin::Multiply && isBuiltin(previous, Builtin::Dup)) {
+                code.resize(n - 2);
+                code.push_back({OpCode::SQUARE, 0, 0.0});
+                return true;
+            }
+            if (op == Builtin::Add && n >= 3 && isPush(previous) && isBuiltin(code[n - 3], Builtin::Multiply)) {
+                double addend = previous.value;
+                code.resize(n - 3);
+                code.push_back({OpCode::MULTIPLY_ADD, 0, addend});
+                return true;
+            }
+            // Both give the same bits either way round, and need the same
+            // two values the swap did
+            if ((op == Builtin::Add || op == Builtin::Multiply) && isBuiltin(previous, Builtin::Swap)) {
+                code.erase(code.end() - 2);
+                return true;
+            }
+            return false;
+
+        case Arity::STACK:
+            break;
+    }
+
+    switch (op) {
+        case Builtin::Dup:
+            if (isPush(previous)) {
+                code.back() = previous;
+                return true;
+            }
+            return false;
+        case Builtin::Drop:
+            if (isPush(previous) || previous.code == OpCode::LOAD_X) {
+                code.resize(n - 2);
+                return true;
+            }
+            if (dropShuffles && (isBuiltin(previous, Builtin::Dup) || isBuiltin(previous, Builtin::Over))) {
+                code.resize(n - 2);
+                return true;
+            }
+            return false;
+        case Builtin::Swap:
+            if (n >= 3 && isPush(code[n - 3]) && isPush(previous)) {
+                std::swap(code[n - 3], previous);
+                code.pop_back();
+                return true;
+            }
+            // The two values on top are equal after a dup
+            if (isBuiltin(previous, Builtin::Dup)) {
+                code.pop_back();
+                return true;
+            }
+            if (dropShuffles && isBuiltin(previous, Builtin::Swap)) {
+                code.resize(n - 2);
+                return true;
+            }
+            return false;
+        case Builtin::Over:
+            if (n >= 3 && isPush(code[n - 3]) && isPush(previous)) {
+                code.back() = code[n - 3];
+                return true;
+            }
+            return false;
+        case Builtin::Rot:
+            if (n >= 4 && isPush(code[n - 4]) && isPush(code[n - 3]) && isPush(previous)) {
+                std::rotate(code.end() - 4, code.end() - 3, code.end() - 1);
+                code.pop_back();
+                return true;
+            }
+            if (dropShuffles && n >= 3 && isBuiltin(code[n - 3], Builtin::Rot) && isBuiltin(previous, Builtin::Rot)) {
+                code.resize(n - 3);
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+Program rewrite(const Program& program, bool dropShuffles) {
+    Program code;
+    code.reserve(program.size());
+    for (const Instruction& instruction : program) {
+        code.push_back(instruction);
+        while (simplifyTail(code, dropShuffles)) {
+        }
+    }
+    return code;
+}
+
+}
+
+Program optimizeProgram(const Program& program) {
+    Program code = rewrite(program, true);
+    // Folding and fusing never change the depth needed; dropping shuffles
+    // can, and then a body that ran out of values would no longer fail
+    if (requiredDepths(code) != requiredDepths(program)) {
+        code = rewrite(program, false);
+    }
+    return code;
+}
+
+}
@@ -0,0 +1,27 @@
+#ifndef PROGRAM_OPTIMIZER_H
+#define PROGRAM_OPTIMIZER_H
+
+#include "Program.h"
+
+namespace RPN {
+
+// Peephole pass over a compiled function body, run once at definition
+// time:
+//   - unary and binary builtins on literals are folded ("2 3 *" -> 6), and
+//     stack shuffles of literals are resolved ("2 3 swap" -> "3 2"); an
+//     operation that would fail ("1 0 /") is left for run time
+//   - shuffles that undo each other ("swap swap", "dup drop", "rot rot
+//     rot") and a swap before + or * are dropped
+//   - "dup *" becomes SQUARE and "* c +" becomes MULTIPLY_ADD
+//
+// The result leaves the same values on the stack as the original, bit for
+// bit. A body that runs out of values still fails, though possibly at a
+// later instruction: a dropped shuffle is only dropped if the rest of the
+// body needs at least as deep a stack. The one other difference is at a
+// full stack, where the original could evict the oldest value and the
+// optimized body, which pushes less, may not.
+Program optimizeProgram(const Program& program);
+
+}
+
+#endif
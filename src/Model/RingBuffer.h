@@ -0,0 +1,121 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <vector>
+#include <cstddef>
+#include <iterator>
+
+namespace RPN {
+
+// Fixed-capacity circular buffer. Pushing onto a full buffer evicts the
+// oldest element, so push, pop and eviction are all O(1). Index 0 is the
+// oldest element and size() - 1 the newest, matching std::vector order.
+template <typename T>
+class RingBuffer {
+public:
+    template <bool IsConst>
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<IsConst, const T*, T*>::type;
+        using reference = typename std::conditional<IsConst, const T&, T&>::type;
+        using Owner = typename std::conditional<IsConst, const RingBuffer, RingBuffer>::type;
+
+        Iterator() = default;
+        Iterator(Owner* owner, size_t index) : owner(owner), index(index) {}
+        operator Iterator<true>() const { return Iterator<true>(owner, index); }
+
+        reference operator*() const { return (*owner)[index]; }
+        pointer operator->() const { return &(*owner)[index]; }
+        reference operator[](difference_type n) const { return (*owner)[index + n]; }
+
+        Iterator& operator++() { ++index; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++index; return tmp; }
+        Iterator& operator--() { --index; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --index; return tmp; }
+        Iterator& operator+=(difference_type n) { index += n; return *this; }
+        Iterator& operator-=(difference_type n) { index -= n; return *this; }
+        Iterator operator+(difference_type n) const { return Iterator(owner, index + n); }
+        Iterator operator-(difference_type n) const { return Iterator(owner, index - n); }
+        difference_type operator-(const Iterator& other) const {
+            return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+        }
+
+        bool operator==(const Iterator& other) const { return index == other.index; }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+        bool operator<(const Iterator& other) const { return index < other.index; }
+        bool operator>(const Iterator& other) const { return index > other.index; }
+        bool operator<=(const Iterator& other) const { return index <= other.index; }
+        bool operator>=(const Iterator& other) const { return index >= other.index; }
+
+    private:
+        Owner* owner = nullptr;
+        size_t index = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    explicit RingBuffer(size_t capacity) : buffer(capacity > 0 ? capacity : 1) {}
+
+    void push_back(const T& value) {
+        if (count == buffer.size()) {
+            buffer[head] = value;
+            head = wrap(head + 1);
+        } else {
+            buffer[wrap(head + count)] = value;
+            ++count;
+        }
+    }
+
+    void pop_back() { --count; }
+    void clear() { head = 0; count = 0; }
+
+    T& back() { return buffer[wrap(head + count - 1)]; }
+    const T& back() const { return buffer[wrap(head + count - 1)]; }
+    T& front() { return buffer[head]; }
+    const T& front() const { return buffer[head]; }
+
+    T& operator[](size_t i) { return buffer[wrap(head + i)]; }
+    const T& operator[](size_t i) const { return buffer[wrap(head + i)]; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == buffer.size(); }
+    size_t capacity() const { return buffer.size(); }
+
+    // Resizes the buffer, keeping the newest elements that still fit.
+    void setCapacity(size_t newCapacity) {
+        if (newCapacity == 0) {
+            newCapacity = 1;
+        }
+        size_t keep = count < newCapacity ? count : newCapacity;
+        std::vector<T> resized(newCapacity);
+        for (size_t i = 0; i < keep; ++i) {
+            resized[i] = (*this)[count - keep + i];
+        }
+        buffer.swap(resized);
+        head = 0;
+        count = keep;
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, count); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+private:
+    std::vector<T> buffer;
+    size_t head = 0;
+    size_t count = 0;
+
+    size_t wrap(size_t index) const {
+        return index >= buffer.size() ? index - buffer.size() : index;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+
+namespace RPN {
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::submit(Task task) {
+    // Count the task before queueing it so a fast worker can never take
+    // it while pending is still zero.
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        pending.fetch_add(1, std::memory_order_release);
+    }
+    unsigned index = nextQueue.fetch_add(1, std::memory_order_relaxed) % size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::takeTask(unsigned worker, Task& task) {
+    {
+        Queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for (unsigned offset = 1; offset < size(); ++offset) {
+        Queue& victim = *queues[(worker + offset) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned worker) {
+    for (;;) {
+        Task task;
+        if (takeTask(worker, task)) {
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+            task(worker);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [this] { return stopping || pending.load(std::memory_order_acquire) > 0; });
+        if (stopping && pending.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain,
+                             const std::function<void(size_t, size_t, unsigned)>& body) {
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    
+    size_t chunks = (count + grain - 1) / grain;
+    std::mutex doneMutex;
+    std::condition_variable done;
+    size_t remaining = chunks;
+    
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        size_t begin = chunk * grain;
+        size_t end = begin + grain < count ? begin + grain : count;
+        submit([&, begin, end](unsigned worker) {
+            body(begin, end, worker);
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (--remaining == 0) {
+                done.notify_one();
+            }
+        });
+    }
+    
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [&] { return remaining == 0; });
+}
+
+}
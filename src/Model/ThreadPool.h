@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RPN {
+
+// Fixed set of worker threads, each with its own task deque. Workers
+// take from the front of their own deque and, when it runs dry, steal
+// from the back of the others', so uneven chunks still balance out.
+class ThreadPool {
+public:
+    // Tasks receive the index of the worker running them, in [0, size()),
+    // so callers can keep per-worker state without locking.
+    using Task = std::function<void(unsigned worker)>;
+    
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Counted from the queues, which are complete before any worker starts
+    unsigned size() const { return static_cast<unsigned>(queues.size()); }
+    
+    // Splits [0, count) into chunks of at most grain and runs
+    // body(begin, end, worker) on the pool, blocking until all are done.
+    // Must not be called from inside a pool task.
+    void parallelFor(size_t count, size_t grain,
+                     const std::function<void(size_t begin, size_t end, unsigned worker)>& body);
+    
+    // Process-wide pool sized to the hardware.
+    static ThreadPool& shared();
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+    
+    void submit(Task task);
+    bool takeTask(unsigned worker, Task& task);
+    void workerLoop(unsigned worker);
+};
+
+}
+
+#endif
@@ -39,7 +39,7 @@ void CalculatorView::render(const CalculatorModel& model) {
     }
 }
 
-void CalculatorView::renderStack(const std::vector<double>& stack) {
+void CalculatorView::renderStack(const RPN::RingBuffer<double>& stack) {
     ImGui::BeginChild("Stack", ImVec2(0, 200), true);
     ImGui::Text("Stack:");
     ImGui::Separator();
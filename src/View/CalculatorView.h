@@ -6,6 +6,7 @@
 #include <functional>
 #include <memory>
 #include <imgui.h>
+#include "../Model/RingBuffer.h"
 
 class CalculatorModel;
 
@@ -47,7 +48,7 @@ private:
         std::function<void()> callback;
     };
     
-    void renderStack(const std::vector<double>& stack);
+    void renderStack(const RPN::RingBuffer<double>& stack);
     void renderInput(const std::string& input);
     void renderError(const std::string& error);
     void renderButtons();
@@ -1,6 +1,7 @@
 #include "GraphView.h"
 #include "../Model/GraphData.h"
-#include "../Model/GraphFunction.h"
+#include "../Model/GraphFunctionSet.h"
+#include "../Model/PlotWorker.h"
 #include "../Model/CalculatorModel.h"
 #include <imgui.h>
 #include <implot.h>
@@ -9,8 +10,32 @@
 
 namespace RPN {
 
+namespace {
+
+// Splits "sin(x); cos(x)" into its expressions, trimmed, dropping empty ones
+std::vector<std::string> SplitExpressions(const std::string& text) {
+    std::vector<std::string> expressions;
+    size_t start = 0;
+    for (;;) {
+        size_t end = text.find(';', start);
+        std::string piece = text.substr(start, end == std::string::npos ? end : end - start);
+        size_t first = piece.find_first_not_of(" \t");
+        if (first != std::string::npos) {
+            size_t last = piece.find_last_not_of(" \t");
+            expressions.push_back(piece.substr(first, last - first + 1));
+        }
+        if (end == std::string::npos) {
+            return expressions;
+        }
+        start = end + 1;
+    }
+}
+
+}
+
 GraphView::GraphView(CalculatorModel* calc) 
-    : calculator(calc), function(std::make_unique<GraphFunction>(calc)) {
+    : calculator(calc), functions(std::make_unique<GraphFunctionSet>(calc)),
+      worker(std::make_unique<PlotWorker>()) {
     ImPlot::CreateContext();
 }
 
@@ -21,6 +46,8 @@ GraphView::~GraphView() {
 void GraphView::Render() {
     if (!visible) return;
     
+    CollectResults();
+    
     ImGui::SetNextWindowSize(ImVec2(600, 500), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Graph View", &visible)) {
         RenderControls();
@@ -33,7 +60,7 @@ void GraphView::Render() {
 void GraphView::RenderControls() {
     static char expressionBuffer[256] = "";
     
-    ImGui::Text("Function Expression (use 'x' as variable):");
+    ImGui::Text("Function Expression (use 'x' as variable, ';' between several):");
     if (ImGui::InputText("f(x)", expressionBuffer, sizeof(expressionBuffer), 
                          ImGuiInputTextFlags_EnterReturnsTrue)) {
         SetExpression(expressionBuffer);
@@ -46,6 +73,12 @@ void GraphView::RenderControls() {
         PlotExpression();
     }
     
+    ImGui::SameLine();
+    if (ImGui::Button("Add")) {
+        SetExpression(expressionBuffer);
+        AddExpression();
+    }
+    
     ImGui::SameLine();
     if (ImGui::Button("Clear")) {
         Clear();
@@ -54,6 +87,25 @@ void GraphView::RenderControls() {
     
     if (!errorMessage.empty()) {
         ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Error: %s", errorMessage.c_str());
+    } else if (evaluationCount > 0) {
+        ImGui::Text("%zu samples evaluated%s", evaluationCount,
+                    worker->IsBusy() ? ", refining..." : "");
+    } else if (worker->IsBusy()) {
+        ImGui::Text("Plotting...");
+    }
+    
+    size_t removed = plottedExpressions.size();
+    for (size_t k = 0; k < plottedExpressions.size(); ++k) {
+        ImGui::PushID(static_cast<int>(k));
+        if (ImGui::SmallButton("x")) {
+            removed = k;
+        }
+        ImGui::SameLine();
+        ImGui::TextUnformatted(plottedExpressions[k].c_str());
+        ImGui::PopID();
+    }
+    if (removed < plottedExpressions.size()) {
+        RemoveExpression(removed);
     }
     
     ImGui::Separator();
@@ -88,20 +140,27 @@ void GraphView::RenderPlot() {
         ImPlot::SetupAxisLimits(ImAxis_X1, xMin, xMax);
         ImPlot::SetupAxisLimits(ImAxis_Y1, yMin, yMax);
         
+        // Series are plotted straight from their arrays, at the level of
+        // detail that fits the visible range and plot width
+        ImPlotRect limits = ImPlot::GetPlotLimits();
+        viewXMin = limits.X.Min;
+        viewXMax = limits.X.Max;
+        viewPixels = static_cast<size_t>(std::max(ImPlot::GetPlotSize().x, 1.0f));
+        
+        // Panning, zooming or redefining a function resamples the
+        // expression in the background; the current curve stays up until
+        // the new one is ready
+        if (!plottedExpressions.empty() &&
+            (viewXMin != sampledXMin || viewXMax != sampledXMax || viewPixels != sampledPixels ||
+             functions->GetFunctionsVersion() != sampledFunctionsVersion)) {
+            SubmitViewport();
+        }
+        
         for (const auto& data : plotData) {
             if (!data->IsEmpty()) {
-                std::vector<double> xData, yData;
-                xData.reserve(data->GetSize());
-                yData.reserve(data->GetSize());
-                
-                for (const auto& point : data->GetPoints()) {
-                    xData.push_back(point.x);
-                    yData.push_back(point.y);
-                }
-                
-                ImPlot::PlotLine(data->GetLabel().c_str(), 
-                                xData.data(), yData.data(), 
-                                static_cast<int>(xData.size()));
+                RPN::GraphData::View view = data->GetLevelOfDetail(viewXMin, viewXMax, viewPixels);
+                ImPlot::PlotLine(data->GetLabel().c_str(), view.x, view.y,
+                                static_cast<int>(view.count));
             }
         }
         
@@ -115,25 +174,123 @@ void GraphView::SetExpression(const std::string& expr) {
 }
 
 void GraphView::PlotExpression() {
-    if (currentExpression.empty()) {
+    std::vector<std::string> expressions = SplitExpressions(currentExpression);
+    if (expressions.empty()) {
+        errorMessage = "Please enter an expression";
+        return;
+    }
+    
+    if (PlotExpressions(expressions)) {
+        replacePlot = true;
+    }
+}
+
+void GraphView::AddExpression() {
+    std::vector<std::string> expressions = SplitExpressions(currentExpression);
+    if (expressions.empty()) {
         errorMessage = "Please enter an expression";
         return;
     }
     
-    if (!function->SetExpression(currentExpression)) {
-        errorMessage = function->GetLastError();
+    expressions.insert(expressions.begin(), plottedExpressions.begin(), plottedExpressions.end());
+    PlotExpressions(expressions);
+}
+
+void GraphView::RemoveExpression(size_t index) {
+    if (index >= plottedExpressions.size()) {
         return;
     }
     
-    auto data = function->Evaluate(xMin, xMax);
-    if (data->IsEmpty()) {
-        errorMessage = "Failed to evaluate function";
+    std::vector<std::string> expressions = plottedExpressions;
+    expressions.erase(expressions.begin() + index);
+    if (!expressions.empty()) {
+        PlotExpressions(expressions);
         return;
     }
     
-    plotData.clear();
-    plotData.push_back(data);
+    worker->Cancel();
+    plotData.erase(std::remove_if(plotData.begin(), plotData.end(),
+                                  [this](const std::shared_ptr<GraphData>& data) {
+                                      return std::find(expressionData.begin(), expressionData.end(), data) !=
+                                             expressionData.end();
+                                  }),
+                   plotData.end());
+    plottedExpressions.clear();
+    expressionData.clear();
+    evaluationCount = 0;
+}
+
+bool GraphView::PlotExpressions(const std::vector<std::string>& expressions) {
+    if (!functions->SetExpressions(expressions)) {
+        errorMessage = functions->GetLastError();
+        return false;
+    }
+    
+    // Before the plot has been drawn once, sample the configured range at
+    // the width available to it
+    if (viewPixels == 0) {
+        ImVec2 plotSize = ImGui::GetContentRegionAvail();
+        viewXMin = xMin;
+        viewXMax = xMax;
+        viewPixels = plotSize.x > 0.0f ? static_cast<size_t>(plotSize.x) : 1000;
+    }
+    
+    plottedExpressions = expressions;
+    evaluationCount = 0;
+    SubmitViewport();
     errorMessage.clear();
+    return true;
+}
+
+void GraphView::SubmitViewport() {
+    PlotWorker::Request request;
+    request.expressions = plottedExpressions;
+    request.functions = calculator->snapshotFunctions();
+    request.xMin = viewXMin;
+    request.xMax = viewXMax;
+    request.pixels = viewPixels;
+    
+    sampledXMin = viewXMin;
+    sampledXMax = viewXMax;
+    sampledPixels = viewPixels;
+    sampledFunctionsVersion = request.functions->getVersion();
+    worker->Submit(std::move(request));
+}
+
+void GraphView::CollectResults() {
+    PlotWorker::Result result;
+    if (!worker->TakeResult(result)) {
+        return;
+    }
+    
+    if (!result.error.empty()) {
+        errorMessage = result.error;
+        plottedExpressions.clear();
+        return;
+    }
+    
+    evaluationCount = result.evaluationCount;
+    if (replacePlot) {
+        plotData.clear();
+    } else {
+        plotData.erase(std::remove_if(plotData.begin(), plotData.end(),
+                                      [this](const std::shared_ptr<GraphData>& data) {
+                                          return std::find(expressionData.begin(), expressionData.end(),
+                                                           data) != expressionData.end();
+                                      }),
+                       plotData.end());
+    }
+    plotData.insert(plotData.begin(), result.series.begin(), result.series.end());
+    expressionData = std::move(result.series);
+    
+    if (result.final) {
+        bool empty = std::all_of(expressionData.begin(), expressionData.end(),
+                                 [](const std::shared_ptr<GraphData>& data) { return data->IsEmpty(); });
+        if (replacePlot && empty) {
+            errorMessage = "Failed to evaluate function";
+        }
+        replacePlot = false;
+    }
 }
 
 void GraphView::PlotData(std::shared_ptr<GraphData> data) {
@@ -143,7 +300,12 @@ void GraphView::PlotData(std::shared_ptr<GraphData> data) {
 }
 
 void GraphView::Clear() {
+    worker->Cancel();
     plotData.clear();
+    plottedExpressions.clear();
+    expressionData.clear();
+    replacePlot = false;
+    evaluationCount = 0;
     currentExpression.clear();
     errorMessage.clear();
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
@@ -8,7 +9,8 @@ class CalculatorModel;
 namespace RPN {
 
 class GraphData;
-class GraphFunction;
+class GraphFunctionSet;
+class PlotWorker;
 
 class GraphView {
 public:
@@ -17,8 +19,13 @@ public:
     
     void Render();
     
+    // Several expressions may be given at once, separated by ';'
     void SetExpression(const std::string& expr);
+    // Replaces the plotted expressions with the current ones
     void PlotExpression();
+    // Plots the current expressions alongside those already shown
+    void AddExpression();
+    void RemoveExpression(size_t index);
     void PlotData(std::shared_ptr<GraphData> data);
     void Clear();
     
@@ -31,8 +38,16 @@ public:
 
 private:
     CalculatorModel* calculator;
-    std::unique_ptr<GraphFunction> function;
+    // Checks expressions on the UI thread before they go to the worker
+    std::unique_ptr<GraphFunctionSet> functions;
+    std::unique_ptr<PlotWorker> worker;
     std::vector<std::shared_ptr<GraphData>> plotData;
+    // The plotted expressions and their entries in plotData, resampled
+    // together in the background as the view moves
+    std::vector<std::string> plottedExpressions;
+    std::vector<std::shared_ptr<GraphData>> expressionData;
+    // The next result replaces everything in plotData
+    bool replacePlot = false;
     
     bool visible = false;
     bool autoFit = true;
@@ -44,9 +59,24 @@ private:
     
     std::string currentExpression;
     std::string errorMessage;
+    size_t evaluationCount = 0;
+    
+    // Visible x range and plot width as of the last frame, and the ones
+    // expressionData was sampled for
+    double viewXMin = 0.0;
+    double viewXMax = 0.0;
+    size_t viewPixels = 0;
+    double sampledXMin = 0.0;
+    double sampledXMax = 0.0;
+    size_t sampledPixels = 0;
+    uint64_t sampledFunctionsVersion = 0;
     
     void RenderControls();
     void RenderPlot();
+    bool PlotExpressions(const std::vector<std::string>& expressions);
+    void SubmitViewport();
+    // Swaps in whatever the worker has finished since the last frame
+    void CollectResults();
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+#include "../src/Model/BatchEvaluator.h"
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/GraphFunction.h"
+#include "../src/Model/SimdMath.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+int64_t ulpDistance(double a, double b) {
+    if (a == b || (std::isnan(a) && std::isnan(b))) {
+        return 0;
+    }
+    int64_t x, y;
+    std::memcpy(&x, &a, sizeof(x));
+    std::memcpy(&y, &b, sizeof(y));
+    if ((x < 0) != (y < 0)) {
+        return std::numeric_limits<int64_t>::max();
+    }
+    return x > y ? x - y : y - x;
+}
+
+template <typename VecFn, typename LibmFn>
+int64_t worstUlp(VecFn vecFn, LibmFn libmFn, double low, double high, bool logScale = false) {
+    using RPN::Simd::Vec;
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> dist(low, high);
+    int64_t worst = 0;
+    for (int i = 0; i < 100000; ++i) {
+        double in[Vec::WIDTH], out[Vec::WIDTH];
+        for (int lane = 0; lane < Vec::WIDTH; ++lane) {
+            in[lane] = logScale ? std::exp(dist(rng)) : dist(rng);
+        }
+        vecFn(Vec::load(in)).store(out);
+        for (int lane = 0; lane < Vec::WIDTH; ++lane) {
+            worst = std::max(worst, ulpDistance(out[lane], libmFn(in[lane])));
+        }
+    }
+    return worst;
+}
+
+}
+
+using RPN::Simd::Vec;
+
+TEST(SimdMathTest, TranscendentalsWithinDocumentedUlps) {
+    auto vsin = [](Vec v) { return RPN::Simd::sin(v); };
+    auto vcos = [](Vec v) { return RPN::Simd::cos(v); };
+    auto vtan = [](Vec v) { return RPN::Simd::tan(v); };
+    auto vexp = [](Vec v) { return RPN::Simd::exp(v); };
+    auto vlog = [](Vec v) { return RPN::Simd::log(v); };
+    auto vlog10 = [](Vec v) { return RPN::Simd::log10(v); };
+    auto ssin = [](double v) { return std::sin(v); };
+    auto scos = [](double v) { return std::cos(v); };
+    auto stan = [](double v) { return std::tan(v); };
+
+    EXPECT_LE(worstUlp(vsin, ssin, -10.0, 10.0), 1);
+    EXPECT_LE(worstUlp(vcos, scos, -10.0, 10.0), 1);
+    EXPECT_LE(worstUlp(vsin, ssin, -1e5, 1e5), 2);
+    EXPECT_LE(worstUlp(vcos, scos, -1e5, 1e5), 2);
+    EXPECT_LE(worstUlp(vtan, stan, -1e5, 1e5), 3);
+    EXPECT_LE(worstUlp(vexp, [](double v) { return std::exp(v); }, -708.0, 709.0), 1);
+    EXPECT_LE(worstUlp(vlog, [](double v) { return std::log(v); }, -700.0, 700.0, true), 1);
+    EXPECT_LE(worstUlp(vlog10, [](double v) { return std::log10(v); }, -700.0, 700.0, true), 2);
+}
+
+TEST(SimdMathTest, SpecialValuesMatchLibm) {
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inputs[] = {0.0, -0.0, inf, -inf, nan, 1e300, -800.0, 750.0, 4.9e-324, 1e6};
+
+    for (double x : inputs) {
+        double in[Vec::WIDTH], out[Vec::WIDTH];
+        std::fill_n(in, Vec::WIDTH, x);
+
+        RPN::Simd::sin(Vec::load(in)).store(out);
+        EXPECT_EQ(ulpDistance(out[0], std::sin(x)), 0) << "sin " << x;
+        RPN::Simd::exp(Vec::load(in)).store(out);
+        EXPECT_EQ(ulpDistance(out[0], std::exp(x)), 0) << "exp " << x;
+        if (x > 0) {
+            RPN::Simd::log(Vec::load(in)).store(out);
+            EXPECT_EQ(ulpDistance(out[0], std::log(x)), 0) << "log " << x;
+        }
+    }
+}
+
+class BatchEvaluatorTest : public ::testing::Test {
+protected:
+    CalculatorModel calc;
+    RPN::GraphFunction function{&calc};
+
+    // Compares EvaluateBatch against the interpreter over a grid, allowing
+    // only the documented ulp error and requiring identical failures.
+    void expectMatchesInterpreter(const std::string& expr, int64_t maxUlps) {
+        ASSERT_TRUE(function.SetExpression(expr)) << function.GetLastError();
+
+        std::vector<double> x(1001), y(x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = -5.0 + i * 0.01;
+        }
+        function.EvaluateBatch(x.data(), y.data(), x.size());
+
+        for (size_t i = 0; i < x.size(); ++i) {
+            double expected = function.EvaluateAtPoint(x[i]);
+            ASSERT_EQ(std::isnan(y[i]), std::isnan(expected)) << expr << " at " << x[i];
+            EXPECT_LE(ulpDistance(y[i], expected), maxUlps) << expr << " at " << x[i];
+        }
+    }
+
+    bool batchable(const std::string& expr) {
+        RPN::BatchEvaluator batch;
+        return function.SetExpression(expr) &&
+               batch.compile(function.GetProgram(), *calc.snapshotFunctions(), 100);
+    }
+};
+
+TEST_F(BatchEvaluatorTest, ArithmeticIsExact) {
+    calc.defineFunction("clamp", {"1", "min", "-1", "max"});
+    calc.defineFunction("tests", {"dup", "1", ">", "swap", "dup", "-1", "<=", "swap", "0", "==", "+", "+"});
+
+    expectMatchesInterpreter("(x * 3 - 1) / (x + 2) + abs(x) ^ 2", 0);
+    expectMatchesInterpreter("1 / x", 0);
+    expectMatchesInterpreter("x % 2 + clamp(x)", 0);
+    expectMatchesInterpreter("sqrt(x) + floor(x) * ceil(x) - round(x)", 0);
+    expectMatchesInterpreter("tests(x * 2)", 0);
+}
+
+TEST_F(BatchEvaluatorTest, TranscendentalsWithinUlps) {
+    expectMatchesInterpreter("sin(x) * cos(x)", 4);
+    expectMatchesInterpreter("exp(x) - ln(x)", 4);
+    expectMatchesInterpreter("log(x * x)", 2);
+    expectMatchesInterpreter("tan(x)", 3);
+}
+
+TEST_F(BatchEvaluatorTest, InlinesFunctionsAndStackOperations) {
+    calc.defineFunction("sq", {"dup", "*"});
+    calc.defineFunction("hyp", {"dup", "sq", "swap", "sq", "+", "sqrt"});
+    calc.defineFunction("third", {"1", "2", "rot", "2", "pick", "*", "+", "2", "roll", "drop"});
+    calc.defineFunction("keep", {"dup", "1", "over", "-", "drop", "drop"});
+
+    EXPECT_TRUE(batchable("hyp(x) + third(x) + keep(x)"));
+    expectMatchesInterpreter("hyp(x) + third(x) + keep(x)", 0);
+}
+
+TEST_F(BatchEvaluatorTest, RejectsDataDependentPrograms) {
+    calc.defineFunction("dyn", {"dup", "pick"});
+    calc.defineFunction("loop", {"loop"});
+    calc.defineFunction("sq", {"dup", "*"});
+
+    EXPECT_TRUE(batchable("sq(x)"));
+    EXPECT_FALSE(batchable("dyn(x)"));
+    EXPECT_FALSE(batchable("loop(x)"));
+
+    // EvaluateBatch falls back to the interpreter
+    expectMatchesInterpreter("x + dyn(x)", 0);
+}
+
+TEST_F(BatchEvaluatorTest, SeesRedefinedFunctions) {
+    calc.defineFunction("f", {"2", "*"});
+    ASSERT_TRUE(function.SetExpression("f(x)"));
+    double x = 3.0, y;
+    function.EvaluateBatch(&x, &y, 1);
+    EXPECT_EQ(y, 6.0);
+
+    calc.defineFunction("f", {"3", "*"});
+    function.EvaluateBatch(&x, &y, 1);
+    EXPECT_EQ(y, 9.0);
+}
+
+TEST_F(BatchEvaluatorTest, SharesOperationsAcrossPrograms) {
+    calc.defineFunction("sq", {"dup", "*"});
+    const char* expressions[] = {"sin(x) * 2", "sin(x) + cos(x)", "sq(sin(x)) + sq(cos(x))", "2 * sin(x) - 1"};
+    auto functions = calc.snapshotFunctions();
+    
+    std::vector<RPN::GraphFunction> single;
+    std::vector<const RPN::Program*> programs;
+    size_t separateOperations = 0;
+    for (const char* expr : expressions) {
+        single.emplace_back(&calc);
+        ASSERT_TRUE(single.back().SetExpression(expr));
+        RPN::BatchEvaluator alone;
+        ASSERT_TRUE(alone.compile(single.back().GetProgram(), *functions, 100));
+        separateOperations += alone.operationCount();
+    }
+    for (auto& f : single) {
+        programs.push_back(&f.GetProgram());
+    }
+    
+    // sin, cos, their squares and sin * 2 are computed once
+    RPN::BatchEvaluator batch;
+    ASSERT_TRUE(batch.compile(programs, *functions, 100));
+    EXPECT_EQ(separateOperations, 13u);
+    EXPECT_EQ(batch.operationCount(), 8u);
+    
+    std::vector<double> x(500);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = -5.0 + i * 0.02;
+    }
+    std::vector<std::vector<double>> y(programs.size(), std::vector<double>(x.size()));
+    std::vector<double*> outputs;
+    for (auto& column : y) {
+        outputs.push_back(column.data());
+    }
+    batch.evaluate(x.data(), outputs.data(), x.size());
+    
+    for (size_t k = 0; k < programs.size(); ++k) {
+        std::vector<double> expected(x.size());
+        single[k].EvaluateBatch(x.data(), expected.data(), x.size());
+        EXPECT_EQ(y[k], expected) << expressions[k];
+    }
+}
+
+TEST_F(BatchEvaluatorTest, ErrorsStayWithTheirPrograms) {
+    calc.defineFunction("dyn", {"dup", "pick"});
+    calc.defineFunction("waste", {"dup", "sqrt", "drop"});
+    const char* expressions[] = {"1 / x", "x + 1", "1 / x + 1", "dyn(x)", "waste(x) + 1"};
+    
+    std::vector<RPN::GraphFunction> single;
+    std::vector<const RPN::Program*> programs;
+    for (const char* expr : expressions) {
+        single.emplace_back(&calc);
+        ASSERT_TRUE(single.back().SetExpression(expr));
+    }
+    for (auto& f : single) {
+        programs.push_back(&f.GetProgram());
+    }
+    
+    RPN::BatchEvaluator batch;
+    ASSERT_TRUE(batch.compile(programs, *calc.snapshotFunctions(), 100));
+    EXPECT_TRUE(batch.isCompiled(0));
+    EXPECT_FALSE(batch.isCompiled(3));
+    EXPECT_TRUE(batch.isCompiled(4));
+    
+    double x[] = {-1.0, 0.0, 2.0};
+    double y[5][3];
+    std::fill(&y[0][0], &y[0][0] + 15, 42.0);
+    double* outputs[] = {y[0], y[1], y[2], y[3], y[4]};
+    batch.evaluate(x, outputs, 3);
+    
+    // The shared division fails only the programs that divide, and the
+    // dropped sqrt still fails its own program, as in the interpreter
+    EXPECT_TRUE(std::isnan(y[0][1]));
+    EXPECT_EQ(y[1][1], 1.0);
+    EXPECT_TRUE(std::isnan(y[2][1]));
+    EXPECT_EQ(y[2][2], 1.5);
+    EXPECT_TRUE(std::isnan(y[4][0]));
+    EXPECT_EQ(y[4][1], 1.0);
+    EXPECT_EQ(y[1][0], 0.0);
+    // Rejected programs are left to the caller
+    EXPECT_EQ(y[3][0], 42.0);
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "../src/Model/CalculatorModel.h"
+#include <algorithm>
 #include <cmath>
 
 class CalculatorModelTest : public ::testing::Test {
@@ -478,4 +479,248 @@ TEST_F(CalculatorModelTest, ComplexFunctionWithNewOps) {
     calc.pushValue(3.0);
     EXPECT_TRUE(calc.executeOperation("max3"));
     EXPECT_EQ(calc.getStack().back(), 10.0);
-}
\ No newline at end of file
+}
+
+TEST_F(CalculatorModelTest, FunctionForwardReference) {
+    // Callees are resolved to slots at definition time and bound when called
+    calc.defineFunction("quad", {"double", "double"});
+    
+    calc.pushValue(3.0);
+    EXPECT_FALSE(calc.executeFunction("quad"));
+    EXPECT_EQ(calc.getError(), "Unknown token in function: double");
+    
+    calc.clear();
+    calc.defineFunction("double", {"2", "*"});
+    calc.pushValue(3.0);
+    EXPECT_TRUE(calc.executeFunction("quad"));
+    EXPECT_EQ(calc.getStack().back(), 12.0);
+    
+    // Redefining a callee is seen by existing callers
+    calc.defineFunction("double", {"3", "*"});
+    calc.clear();
+    calc.pushValue(1.0);
+    EXPECT_TRUE(calc.executeFunction("quad"));
+    EXPECT_EQ(calc.getStack().back(), 9.0);
+}
+
+TEST_F(CalculatorModelTest, SmallCalleesAreInlined) {
+    auto calls = [this](const std::string& name) {
+        uint32_t slot;
+        EXPECT_TRUE(calc.findFunction(name, slot));
+        const RPN::Program& code = calc.getFunctions()[slot].code;
+        return std::count_if(code.begin(), code.end(), [](const RPN::Instruction& instruction) {
+            return instruction.code == RPN::OpCode::CALL;
+        });
+    };
+    
+    calc.defineFunction("cube", {"dup", "square", "*"});
+    EXPECT_EQ(calls("cube"), 1);
+    calc.defineFunction("square", {"dup", "*"});
+    EXPECT_EQ(calls("cube"), 0);
+    calc.defineFunction("twice", {"cube", "cube"});
+    EXPECT_EQ(calls("twice"), 0);
+    
+    calc.pushValue(2.0);
+    EXPECT_TRUE(calc.executeFunction("twice"));
+    EXPECT_EQ(calc.getStack().back(), 512.0);
+    
+    // Redefining a callee re-inlines it all the way up
+    calc.defineFunction("square", {"2", "*"});
+    calc.clear();
+    calc.pushValue(3.0);
+    EXPECT_TRUE(calc.executeFunction("twice"));
+    EXPECT_EQ(calc.getStack().back(), 648.0);
+    
+    // Recursive and large callees stay calls
+    calc.defineFunction("forever", {"1", "+", "forever"});
+    calc.defineFunction("ping", {"square", "pong"});
+    calc.defineFunction("pong", {"ping"});
+    std::vector<std::string> big(RPN::FunctionTable::MAX_INLINE_SIZE + 1, "sin");
+    calc.defineFunction("big", big);
+    calc.defineFunction("user", {"forever", "ping", "big"});
+    EXPECT_EQ(calls("forever"), 1);
+    EXPECT_EQ(calls("ping"), 1);
+    EXPECT_EQ(calls("pong"), 1);
+    EXPECT_EQ(calls("user"), 3);
+}
+
+TEST_F(CalculatorModelTest, UndefinedFunctionIsNotDefined) {
+    calc.defineFunction("caller", {"missing"});
+    EXPECT_TRUE(calc.isFunctionDefined("caller"));
+    EXPECT_FALSE(calc.isFunctionDefined("missing"));
+    EXPECT_FALSE(calc.executeFunction("missing"));
+}
+
+TEST_F(CalculatorModelTest, StackOperationsByName) {
+    calc.pushValue(1.0);
+    calc.pushValue(2.0);
+    EXPECT_TRUE(calc.executeOperation("swap"));
+    EXPECT_EQ(calc.getStack()[0], 2.0);
+    EXPECT_EQ(calc.getStack()[1], 1.0);
+    
+    EXPECT_TRUE(calc.executeOperation("drop"));
+    EXPECT_EQ(calc.getStack().size(), 1);
+    
+    EXPECT_TRUE(calc.executeOperation("drop"));
+    EXPECT_FALSE(calc.executeOperation("drop"));
+    EXPECT_EQ(calc.getError(), "Stack is empty");
+}
+
+TEST_F(CalculatorModelTest, StackOperationsInFunctions) {
+    calc.defineFunction("under", {"rot", "rot", "over"});
+    EXPECT_FALSE(calc.defineFunction("rot", {"swap"}));
+    // drop and swap are builtins too, so they are reserved like rot
+    EXPECT_FALSE(calc.defineFunction("drop", {"+"}));
+    EXPECT_EQ(calc.getError(), "Cannot redefine built-in operation: drop");
+    EXPECT_FALSE(calc.defineFunction("swap", {"over"}));
+    
+    calc.pushValue(1.0);
+    calc.pushValue(2.0);
+    calc.pushValue(3.0);
+    EXPECT_TRUE(calc.executeFunction("under"));
+    EXPECT_EQ(calc.getStack().size(), 4);
+    EXPECT_EQ(calc.getStack()[0], 3.0);
+    EXPECT_EQ(calc.getStack()[1], 1.0);
+    EXPECT_EQ(calc.getStack()[2], 2.0);
+    EXPECT_EQ(calc.getStack()[3], 1.0);
+}
+
+TEST_F(CalculatorModelTest, StackEvictsOldestAtCapacity) {
+    EXPECT_EQ(calc.getStackCapacity(), CalculatorModel::DEFAULT_STACK_CAPACITY);
+    
+    for (int i = 0; i < 150; ++i) {
+        calc.pushValue(i);
+    }
+    EXPECT_EQ(calc.getStack().size(), 100);
+    EXPECT_EQ(calc.getStack()[0], 50.0);
+    EXPECT_EQ(calc.getStack().back(), 149.0);
+    
+    // Stack operations index across the wrap point
+    calc.pushValue(3.0);
+    EXPECT_TRUE(calc.executeOperation("roll"));
+    EXPECT_EQ(calc.getStack().size(), 99);
+    EXPECT_EQ(calc.getStack()[96], 149.0);
+    EXPECT_EQ(calc.getStack()[97], 147.0);
+    EXPECT_EQ(calc.getStack()[98], 148.0);
+}
+
+TEST_F(CalculatorModelTest, ConfigurableStackCapacity) {
+    CalculatorModel small(3);
+    for (int i = 1; i <= 5; ++i) {
+        small.pushValue(i);
+    }
+    
+    std::vector<double> values(small.getStack().begin(), small.getStack().end());
+    EXPECT_EQ(values, (std::vector<double>{3.0, 4.0, 5.0}));
+    
+    small.setStackCapacity(2);
+    EXPECT_EQ(small.getStack().size(), 2);
+    EXPECT_EQ(small.getStack()[0], 4.0);
+    EXPECT_EQ(small.getStack()[1], 5.0);
+}
+
+TEST_F(CalculatorModelTest, HistoryFormatting) {
+    calc.defineFunction("double", {"2", "*"});
+    calc.setInputBuffer("2.5");
+    calc.enterInput();
+    calc.executeOperation("sqrt");
+    calc.executeFunction("double");
+    
+    std::vector<std::string> text;
+    for (const auto& entry : calc.getHistory()) {
+        text.push_back(calc.formatHistoryEntry(entry));
+    }
+    // Builtins run by a function are recorded before the function itself
+    EXPECT_EQ(text, (std::vector<std::string>{"def double", "2.5", "sqrt", "*", "double"}));
+}
+
+TEST_F(CalculatorModelTest, HistoryCapacity) {
+    calc.pushValue(1.0);
+    for (int i = 0; i < 60; ++i) {
+        calc.executeOperation("abs");
+    }
+    EXPECT_EQ(calc.getHistory().size(), CalculatorModel::DEFAULT_HISTORY_CAPACITY);
+    
+    CalculatorModel audit(CalculatorModel::DEFAULT_STACK_CAPACITY, 5000);
+    audit.pushValue(1.0);
+    for (int i = 0; i < 4000; ++i) {
+        audit.executeOperation("abs");
+    }
+    EXPECT_EQ(audit.getHistory().size(), 4000);
+}
+
+TEST_F(CalculatorModelTest, ReciprocalIsNotANumberPrefix) {
+    // "1/x" must run the operation rather than push the "1" prefix
+    calc.pushValue(4.0);
+    calc.setInputBuffer("1/x");
+    EXPECT_TRUE(calc.enterInput());
+    EXPECT_EQ(calc.getStack().size(), 1);
+    EXPECT_EQ(calc.getStack().back(), 0.25);
+    
+    calc.defineFunction("inv", {"1/x"});
+    EXPECT_TRUE(calc.executeFunction("inv"));
+    EXPECT_EQ(calc.getStack().back(), 4.0);
+}
+
+TEST_F(CalculatorModelTest, ExecuteScript) {
+    auto result = calc.executeScript("3 4 + 2 *");
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(result.tokensExecuted, 5);
+    EXPECT_EQ(calc.getStack().size(), 1);
+    EXPECT_EQ(calc.getStack().back(), 14.0);
+}
+
+TEST_F(CalculatorModelTest, ExecuteScriptInlineDefinitions) {
+    auto result = calc.executeScript("sq { dup * }\n cube{dup sq *} 3 cube 2 sq +");
+    EXPECT_TRUE(result.success);
+    EXPECT_EQ(result.tokensExecuted, 7);
+    EXPECT_EQ(result.functionsDefined, 2);
+    EXPECT_TRUE(calc.isFunctionDefined("sq"));
+    EXPECT_TRUE(calc.isFunctionDefined("cube"));
+    EXPECT_EQ(calc.getStack().back(), 31.0);
+}
+
+TEST_F(CalculatorModelTest, ExecuteScriptReportsFailingToken) {
+    auto result = calc.executeScript("1 2 + bogus 5");
+    EXPECT_FALSE(result.success);
+    EXPECT_EQ(result.errorOffset, 6);
+    EXPECT_EQ(result.errorToken, "bogus");
+    EXPECT_EQ(calc.getError(), "Invalid input: bogus");
+    // Tokens before the failure remain applied
+    EXPECT_EQ(calc.getStack().size(), 1);
+    EXPECT_EQ(calc.getStack().back(), 3.0);
+    
+    result = calc.executeScript("1 0 /");
+    EXPECT_FALSE(result.success);
+    EXPECT_EQ(result.errorOffset, 4);
+    EXPECT_EQ(calc.getError(), "Division by zero");
+    
+    result = calc.executeScript("f { dup *");
+    EXPECT_FALSE(result.success);
+    EXPECT_EQ(result.errorToken, "f");
+    EXPECT_FALSE(calc.isFunctionDefined("f"));
+}
+
+TEST_F(CalculatorModelTest, EnterInputRunsWholeLine) {
+    calc.setInputBuffer("2 3 ^");
+    EXPECT_TRUE(calc.enterInput());
+    EXPECT_EQ(calc.getStack().back(), 8.0);
+    EXPECT_TRUE(calc.getInputBuffer().empty());
+}
+
+TEST_F(CalculatorModelTest, EnterInputKeepsOnlyTheFailedRest) {
+    calc.setInputBuffer("1 0 / 5");
+    EXPECT_FALSE(calc.enterInput());
+    EXPECT_EQ(calc.getError(), "Division by zero");
+    EXPECT_EQ(calc.getInputBuffer(), "/ 5");
+    EXPECT_EQ(calc.getStack().size(), 2);
+    
+    // Retrying does not push 1 and 0 a second time
+    EXPECT_FALSE(calc.enterInput());
+    EXPECT_EQ(calc.getStack().size(), 2);
+    
+    calc.setInputBuffer("drop 4 /");
+    EXPECT_TRUE(calc.enterInput());
+    EXPECT_EQ(calc.getStack().size(), 1);
+    EXPECT_EQ(calc.getStack().back(), 0.25);
+}
@@ -0,0 +1,24 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/EvaluationContext.h"
+
+TEST(EvaluationContextTest, ContextsAreIndependent) {
+    CalculatorModel calc;
+    calc.defineFunction("sq", {"dup", "*"});
+    
+    RPN::EvaluationContext first = calc.createContext();
+    first.pushValue(3.0);
+    RPN::EvaluationContext second = first;
+    
+    uint32_t slot;
+    ASSERT_TRUE(calc.findFunction("sq", slot));
+    EXPECT_TRUE(first.callFunction(slot));
+    EXPECT_EQ(first.getStack().back(), 9.0);
+    EXPECT_EQ(second.getStack().back(), 3.0);
+    EXPECT_TRUE(calc.getStack().empty());
+    
+    // A snapshot is unaffected by later definitions
+    calc.defineFunction("sq", {"dup", "dup", "*", "*"});
+    EXPECT_TRUE(second.callFunction(slot));
+    EXPECT_EQ(second.getStack().back(), 9.0);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/ExpressionCache.h"
+#include "../src/Model/GraphFunction.h"
+
+TEST(ExpressionCacheTest, ReusesCompiledExpressions) {
+    CalculatorModel calc;
+    RPN::GraphFunction function(&calc);
+    RPN::ExpressionCache cache;
+    function.SetExpressionCache(&cache);
+    ASSERT_TRUE(function.SetExpression("x * 2 + 1"));
+    EXPECT_EQ(cache.GetMisses(), 1u);
+    
+    // Same expression up to spacing, compiled by another function
+    RPN::GraphFunction other(&calc);
+    other.SetExpressionCache(&cache);
+    ASSERT_TRUE(other.SetExpression("  x*2 +  1 "));
+    EXPECT_EQ(cache.GetHits(), 1u);
+    EXPECT_EQ(cache.GetSize(), 1u);
+    EXPECT_DOUBLE_EQ(other.EvaluateAtPoint(3.0), 7.0);
+    EXPECT_EQ(other.Evaluate(0.0, 1.0, 2)->GetY()[1], 3.0);
+    
+    // Failures are not cached
+    EXPECT_FALSE(other.SetExpression("nosuch(x)"));
+    EXPECT_FALSE(other.SetExpression("nosuch(x)"));
+    EXPECT_EQ(cache.GetSize(), 1u);
+    
+    // A new definition changes the key
+    calc.defineFunction("sq", {"dup", "*"});
+    ASSERT_TRUE(other.SetExpression("x * 2 + 1"));
+    EXPECT_EQ(cache.GetHits(), 1u);
+    EXPECT_EQ(cache.GetSize(), 2u);
+}
+
+TEST(ExpressionCacheTest, NormalizeKeepsMeaningfulSpaces) {
+    using RPN::ExpressionCache;
+    EXPECT_EQ(ExpressionCache::Normalize(" sin ( x ) *  2 "), "sin(x)*2");
+    EXPECT_EQ(ExpressionCache::Normalize("sqrt x"), "sqrt x");
+    EXPECT_EQ(ExpressionCache::Normalize("x  +\t1"), "x + 1");
+    EXPECT_EQ(ExpressionCache::Normalize("1e - 5"), "1e - 5");
+}
+
+TEST(ExpressionCacheTest, SeparatesCalculatorsAndEvicts) {
+    RPN::ExpressionCache cache(2);
+    CalculatorModel first, second;
+    first.defineFunction("f", {"2", "*"});
+    second.defineFunction("f", {"3", "*"});
+    
+    RPN::GraphFunction a(&first), b(&second);
+    a.SetExpressionCache(&cache);
+    b.SetExpressionCache(&cache);
+    ASSERT_TRUE(a.SetExpression("f(x)"));
+    ASSERT_TRUE(b.SetExpression("f(x)"));
+    EXPECT_EQ(cache.GetHits(), 0u);
+    EXPECT_DOUBLE_EQ(a.EvaluateAtPoint(1.0), 2.0);
+    EXPECT_DOUBLE_EQ(b.EvaluateAtPoint(1.0), 3.0);
+    
+    // a's entry is the least recently used and goes first
+    ASSERT_TRUE(b.SetExpression("x + 1"));
+    EXPECT_EQ(cache.GetSize(), 2u);
+    ASSERT_TRUE(b.SetExpression("f(x)"));
+    EXPECT_EQ(cache.GetHits(), 1u);
+    ASSERT_TRUE(a.SetExpression("f(x)"));
+    EXPECT_EQ(cache.GetHits(), 1u);
+    EXPECT_DOUBLE_EQ(a.EvaluateAtPoint(1.0), 2.0);
+}
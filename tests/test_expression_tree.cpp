@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "../src/Model/EvaluationContext.h"
+#include "../src/Model/ExpressionTree.h"
+#include "../src/Model/FunctionTable.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+using RPN::Builtin;
+using RPN::ExpressionTree;
+
+namespace {
+
+size_t countBuiltin(const RPN::Program& program, Builtin op) {
+    return std::count_if(program.begin(), program.end(), [op](const RPN::Instruction& instruction) {
+        return instruction.code == RPN::OpCode::BUILTIN && instruction.index == static_cast<uint32_t>(op);
+    });
+}
+
+double run(const RPN::Program& program, double x, size_t stackCapacity = 100) {
+    RPN::EvaluationContext context(std::make_shared<const RPN::FunctionTable>(), stackCapacity);
+    double result = 0.0;
+    EXPECT_TRUE(context.evaluate(program, x, result));
+    return result;
+}
+
+}
+
+TEST(ExpressionTreeTest, SharesIdenticalSubexpressions) {
+    ExpressionTree tree;
+    uint32_t first = tree.operation(Builtin::Sin, tree.x());
+    uint32_t second = tree.operation(Builtin::Sin, tree.x());
+    EXPECT_EQ(first, second);
+    
+    uint32_t two = tree.constant(2.0);
+    EXPECT_EQ(tree.operation(Builtin::Add, first, two), tree.operation(Builtin::Add, two, first));
+    EXPECT_NE(tree.operation(Builtin::Subtract, first, two), tree.operation(Builtin::Subtract, two, first));
+}
+
+TEST(ExpressionTreeTest, FoldsConstants) {
+    ExpressionTree tree;
+    uint32_t sum = tree.operation(Builtin::Add, tree.constant(2.0), tree.constant(3.0));
+    ASSERT_EQ(tree.at(sum).kind, ExpressionTree::Kind::CONSTANT);
+    EXPECT_EQ(tree.at(sum).value, 5.0);
+    
+    uint32_t root = tree.operation(Builtin::Sqrt, tree.constant(16.0));
+    EXPECT_EQ(tree.at(root).value, 4.0);
+    
+    // Failing operations are left for run time
+    uint32_t quotient = tree.operation(Builtin::Divide, tree.constant(1.0), tree.constant(0.0));
+    EXPECT_EQ(tree.at(quotient).kind, ExpressionTree::Kind::OPERATION);
+}
+
+TEST(ExpressionTreeTest, Simplifies) {
+    ExpressionTree tree;
+    uint32_t x = tree.x();
+    EXPECT_EQ(tree.operation(Builtin::Multiply, x, tree.constant(1.0)), x);
+    EXPECT_EQ(tree.operation(Builtin::Multiply, tree.constant(1.0), x), x);
+    EXPECT_EQ(tree.operation(Builtin::Add, x, tree.constant(0.0)), x);
+    EXPECT_EQ(tree.operation(Builtin::Subtract, x, tree.constant(0.0)), x);
+    EXPECT_EQ(tree.operation(Builtin::Divide, x, tree.constant(1.0)), x);
+    EXPECT_EQ(tree.operation(Builtin::Power, x, tree.constant(1.0)), x);
+    EXPECT_EQ(tree.operation(Builtin::Negate, tree.operation(Builtin::Negate, x)), x);
+    
+    uint32_t square = tree.operation(Builtin::Power, x, tree.constant(2.0));
+    EXPECT_EQ(tree.at(square).op, Builtin::Multiply);
+    EXPECT_EQ(tree.at(square).a, x);
+    EXPECT_EQ(tree.at(square).b, x);
+    
+    // 0 * x is not 0 for infinite or NaN x
+    EXPECT_NE(tree.operation(Builtin::Multiply, tree.constant(0.0), x), tree.constant(0.0));
+}
+
+TEST(ExpressionTreeTest, EmitsSharedValuesOnce) {
+    // sin(x) * sin(x) + sin(x)
+    ExpressionTree tree;
+    uint32_t sine = tree.operation(Builtin::Sin, tree.x());
+    uint32_t root = tree.operation(Builtin::Add, tree.operation(Builtin::Multiply, sine, sine), sine);
+    
+    RPN::Program program;
+    tree.emit(root, 100, program);
+    EXPECT_EQ(countBuiltin(program, Builtin::Sin), 1u);
+    for (double x : {-2.0, 0.0, 0.7, 3.0}) {
+        EXPECT_DOUBLE_EQ(run(program, x), std::sin(x) * std::sin(x) + std::sin(x));
+    }
+    
+    // Cheap shared values are recomputed rather than copied
+    uint32_t cheap = tree.operation(Builtin::Negate, tree.x());
+    tree.emit(tree.operation(Builtin::Multiply, cheap, cheap), 100, program);
+    EXPECT_TRUE(std::none_of(program.begin(), program.end(), [](const RPN::Instruction& instruction) {
+        return instruction.code == RPN::OpCode::COPY;
+    }));
+    EXPECT_EQ(run(program, 3.0), 9.0);
+}
+
+TEST(ExpressionTreeTest, RecomputesWhenStackIsShort) {
+    // Two shared values and a temporary need four slots when kept
+    ExpressionTree tree;
+    uint32_t sine = tree.operation(Builtin::Sin, tree.x());
+    uint32_t cosine = tree.operation(Builtin::Cos, tree.x());
+    uint32_t left = tree.operation(Builtin::Multiply, sine, cosine);
+    uint32_t right = tree.operation(Builtin::Subtract, sine, cosine);
+    uint32_t root = tree.operation(Builtin::Divide, left, right);
+    
+    RPN::Program program;
+    tree.emit(root, 100, program);
+    EXPECT_EQ(countBuiltin(program, Builtin::Sin), 1u);
+    tree.emit(root, 3, program);
+    EXPECT_EQ(countBuiltin(program, Builtin::Sin), 2u);
+    double x = 0.3;
+    EXPECT_DOUBLE_EQ(run(program, x, 3), std::sin(x) * std::cos(x) / (std::sin(x) - std::cos(x)));
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "../src/Model/GraphData.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+TEST(GraphDataTest, SetDataTakesArraysAsIs) {
+    std::vector<double> xs = {1.0, 2.0, 3.0};
+    std::vector<double> ys = {4.0, 5.0};
+    const double* storage = xs.data();
+    
+    RPN::GraphData data;
+    data.SetData(std::move(xs), std::move(ys));
+    
+    // Moved in rather than copied, and trimmed to the shorter array
+    EXPECT_EQ(data.GetX().data(), storage);
+    ASSERT_EQ(data.GetSize(), 2u);
+    EXPECT_EQ(data.GetPoint(1).x, 2.0);
+    EXPECT_EQ(data.GetPoint(1).y, 5.0);
+    
+    data.AddPoint(0.0, -1.0);
+    double xMin, xMax, yMin, yMax;
+    data.GetBounds(xMin, xMax, yMin, yMax);
+    EXPECT_EQ(xMin, 0.0);
+    EXPECT_EQ(xMax, 2.0);
+    EXPECT_EQ(yMin, -1.0);
+    EXPECT_EQ(yMax, 5.0);
+}
+
+TEST(GraphDataTest, BoundsTrackMutations) {
+    RPN::GraphData data;
+    std::vector<double> xs(1001), ys(1001);
+    for (size_t i = 0; i < xs.size(); ++i) {
+        xs[i] = i * 0.5 - 100.0;
+        ys[i] = std::sin(i * 0.01) * 7.0;
+    }
+    ys[500] = std::numeric_limits<double>::quiet_NaN();
+    double expectedYMin = 0.0, expectedYMax = 0.0;
+    for (double y : ys) {
+        expectedYMin = std::min(expectedYMin, y);
+        expectedYMax = std::max(expectedYMax, y);
+    }
+    data.SetData(xs, ys);
+    
+    double xMin, xMax, yMin, yMax;
+    data.GetBounds(xMin, xMax, yMin, yMax);
+    EXPECT_EQ(xMin, -100.0);
+    EXPECT_EQ(xMax, 400.0);
+    EXPECT_EQ(yMin, expectedYMin);
+    EXPECT_EQ(yMax, expectedYMax);
+    
+    data.AddPoint(500.0, 8.0);
+    data.GetBounds(xMin, xMax, yMin, yMax);
+    EXPECT_EQ(xMax, 500.0);
+    EXPECT_EQ(yMax, 8.0);
+    
+    data.SetData({1.0}, {2.0});
+    data.GetBounds(xMin, xMax, yMin, yMax);
+    EXPECT_EQ(xMin, 1.0);
+    EXPECT_EQ(yMax, 2.0);
+    
+    data.Clear();
+    data.GetBounds(xMin, xMax, yMin, yMax);
+    EXPECT_EQ(xMin, 0.0);
+    EXPECT_EQ(yMax, 0.0);
+}
+
+TEST(GraphDataTest, LevelOfDetailKeepsEnvelope) {
+    const size_t points = 1000000;
+    std::vector<double> xs(points), ys(points);
+    for (size_t i = 0; i < points; ++i) {
+        xs[i] = i * 0.001;
+        ys[i] = std::sin(i * 0.001) + ((i * 7919) % 13 == 0 ? 3.0 : 0.0);
+    }
+    ys[777777] = -5.0;
+    RPN::GraphData data;
+    data.SetData(xs, ys);
+    
+    // The full range at 1000 pixels comes back at two to eight samples
+    // per pixel, with every spike still in it
+    RPN::GraphData::View view = data.GetLevelOfDetail(0.0, 1000.0, 1000);
+    EXPECT_GE(view.count, 2000u);
+    EXPECT_LE(view.count, 8000u);
+    double yMin, yMax, xMin, xMax;
+    data.GetBounds(xMin, xMax, yMin, yMax);
+    EXPECT_EQ(*std::min_element(view.y, view.y + view.count), yMin);
+    EXPECT_EQ(*std::max_element(view.y, view.y + view.count), yMax);
+    EXPECT_TRUE(std::is_sorted(view.x, view.x + view.count));
+    
+    // Zoomed far enough in, the raw samples are used in place with one
+    // extra sample either side
+    view = data.GetLevelOfDetail(100.0, 101.0, 1000);
+    EXPECT_EQ(view.x, &data.GetX()[99999]);
+    EXPECT_EQ(view.count, 1003u);
+    
+    // A point added afterwards drops the pyramid rather than decimating
+    // again on the caller's thread
+    data.AddPoint(1000.0, 0.0);
+    view = data.GetLevelOfDetail(0.0, 1000.0, 1000);
+    EXPECT_EQ(view.count, points + 1);
+    
+    // Data that changes is decimated again
+    data.SetData(xs, ys);
+    EXPECT_LE(data.GetLevelOfDetail(0.0, 1000.0, 1000).count, 8000u);
+    data.SetData({1.0, 2.0}, {3.0, 4.0});
+    view = data.GetLevelOfDetail(0.0, 10.0, 1000);
+    EXPECT_EQ(view.count, 2u);
+    
+    // Unsorted series cannot be trimmed, so they are drawn in full
+    std::reverse(xs.begin(), xs.end());
+    data.SetData(xs, ys);
+    view = data.GetLevelOfDetail(0.0, 1000.0, 1000);
+    EXPECT_EQ(view.count, points);
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/GraphFunction.h"
+#include "../src/Model/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+class GraphFunctionTest : public ::testing::Test {
+protected:
+    CalculatorModel calc;
+    RPN::GraphFunction function{&calc};
+};
+
+TEST_F(GraphFunctionTest, EvaluatesPolynomial) {
+    ASSERT_TRUE(function.SetExpression("x * x + 2 * x + 1"));
+    EXPECT_DOUBLE_EQ(function.EvaluateAtPoint(3.0), 16.0);
+    EXPECT_DOUBLE_EQ(function.EvaluateAtPoint(-1.0), 0.0);
+}
+
+TEST_F(GraphFunctionTest, UsesExactXValues) {
+    // x is bound directly, not pasted into the text with limited precision
+    ASSERT_TRUE(function.SetExpression("x * 1000000"));
+    EXPECT_DOUBLE_EQ(function.EvaluateAtPoint(1.23456789e-7), 0.123456789);
+}
+
+TEST_F(GraphFunctionTest, BuiltinAndUserFunctions) {
+    calc.defineFunction("sq", {"dup", "*"});
+    ASSERT_TRUE(function.SetExpression("sq(sin(x)) + sq(cos(x))"));
+    EXPECT_NEAR(function.EvaluateAtPoint(0.7), 1.0, 1e-12);
+}
+
+TEST_F(GraphFunctionTest, EvaluateSkipsInvalidSamples) {
+    ASSERT_TRUE(function.SetExpression("sqrt(x)"));
+    auto data = function.Evaluate(-1.0, 1.0, 5);
+    // -1 and -0.5 fail with a domain error and are dropped
+    EXPECT_EQ(data->GetSize(), 3);
+    EXPECT_DOUBLE_EQ(data->GetY().back(), 1.0);
+}
+
+TEST_F(GraphFunctionTest, RejectsMalformedExpressions) {
+    EXPECT_FALSE(function.SetExpression("x +"));
+    EXPECT_TRUE(function.HasError());
+    EXPECT_FALSE(function.SetExpression("foo(x)"));
+    EXPECT_EQ(function.GetLastError(), "Unknown identifier: foo");
+    EXPECT_FALSE(function.SetExpression("2 + 3"));
+}
+
+TEST_F(GraphFunctionTest, UnaryMinus) {
+    ASSERT_TRUE(function.SetExpression("-x ^ 2 + 2 * -x"));
+    EXPECT_DOUBLE_EQ(function.EvaluateAtPoint(3.0), -15.0);
+    ASSERT_TRUE(function.SetExpression("x * 1e-3"));
+    EXPECT_DOUBLE_EQ(function.EvaluateAtPoint(2.0), 0.002);
+    EXPECT_FALSE(function.SetExpression("sin(x"));
+    EXPECT_EQ(function.GetLastError(), "Mismatched parentheses");
+}
+
+TEST_F(GraphFunctionTest, ComputesSharedSubexpressionsOnce) {
+    ASSERT_TRUE(function.SetExpression("sin(x) * sin(x) + sin(x) + x ^ 2 * 1"));
+    const auto& program = function.GetProgram();
+    auto sines = std::count_if(program.begin(), program.end(), [](const RPN::Instruction& instruction) {
+        return instruction.code == RPN::OpCode::BUILTIN &&
+               instruction.index == static_cast<uint32_t>(RPN::Builtin::Sin);
+    });
+    EXPECT_EQ(sines, 1);
+    
+    double x = 1.3;
+    double expected = std::sin(x) * std::sin(x) + std::sin(x) + x * x;
+    EXPECT_DOUBLE_EQ(function.EvaluateAtPoint(x), expected);
+    EXPECT_NEAR(function.Evaluate(x, x + 1.0, 2)->GetY()[0], expected, 1e-12);
+}
+
+TEST_F(GraphFunctionTest, DoesNotClobberCalculatorStack) {
+    calc.pushValue(42.0);
+    calc.pushValue(0.0);
+    calc.executeOperation("1/x");
+    ASSERT_TRUE(calc.hasError());
+    
+    ASSERT_TRUE(function.SetExpression("x * 2"));
+    function.Evaluate(0.0, 1.0, 10);
+    
+    EXPECT_EQ(calc.getStack().size(), 2);
+    EXPECT_EQ(calc.getStack()[0], 42.0);
+    EXPECT_EQ(calc.getError(), "Division by zero");
+}
+
+TEST_F(GraphFunctionTest, SeesRedefinedFunctions) {
+    calc.defineFunction("f", {"2", "*"});
+    ASSERT_TRUE(function.SetExpression("f(x)"));
+    EXPECT_EQ(function.Evaluate(1.0, 2.0, 2)->GetY()[0], 2.0);
+    
+    calc.defineFunction("f", {"3", "*"});
+    EXPECT_EQ(function.Evaluate(1.0, 2.0, 2)->GetY()[0], 3.0);
+}
+
+TEST_F(GraphFunctionTest, ParallelEvaluateMatchesSerial) {
+    calc.defineFunction("f", {"sin", "2", "*"});
+    ASSERT_TRUE(function.SetExpression("f(x) / x + sqrt(x)"));
+    
+    RPN::ThreadPool single(1);
+    function.SetThreadPool(&single);
+    auto serial = function.Evaluate(-50.0, 50.0, 20000);
+    
+    RPN::ThreadPool pool(4);
+    function.SetThreadPool(&pool);
+    auto data = function.Evaluate(-50.0, 50.0, 20000);
+    
+    // Negative x fails sqrt and is dropped
+    ASSERT_EQ(data->GetSize(), 10000u);
+    ASSERT_EQ(serial->GetSize(), data->GetSize());
+    double step = 100.0 / 19999;
+    for (size_t i = 0; i < data->GetSize(); ++i) {
+        double x = data->GetX()[i];
+        double y = data->GetY()[i];
+        EXPECT_DOUBLE_EQ(x, -50.0 + (10000 + i) * step);
+        EXPECT_EQ(x, serial->GetX()[i]);
+        EXPECT_EQ(y, serial->GetY()[i]);
+        // The batch kernels may differ from libm by a few ulp
+        EXPECT_NEAR(y, function.EvaluateAtPoint(x), 1e-13 * std::abs(y));
+    }
+}
+
+TEST_F(GraphFunctionTest, AdaptiveSamplingMeetsToleranceWithFewerEvaluations) {
+    ASSERT_TRUE(function.SetExpression("sin(x) * 3"));
+    
+    RPN::SamplingOptions options;
+    options.xPixel = 20.0 / 800;
+    options.yPixel = 20.0 / 600;
+    function.ResetEvaluationCount();
+    auto data = function.EvaluateAdaptive(-10.0, 10.0, options);
+    EXPECT_LT(function.GetEvaluationCount(), 500u);
+    
+    // Every segment stays within the tolerance of the curve at its middle
+    const auto& xs = data->GetX();
+    const auto& ys = data->GetY();
+    ASSERT_GT(xs.size(), 2u);
+    EXPECT_EQ(xs.front(), -10.0);
+    EXPECT_EQ(xs.back(), 10.0);
+    for (size_t i = 0; i + 1 < xs.size(); ++i) {
+        ASSERT_LT(xs[i], xs[i + 1]);
+        double xm = 0.5 * (xs[i] + xs[i + 1]);
+        double chord = 0.5 * (ys[i] + ys[i + 1]);
+        EXPECT_LT(std::abs(function.EvaluateAtPoint(xm) - chord) / options.yPixel, 2 * options.tolerance);
+    }
+    
+    function.ResetEvaluationCount();
+    function.Evaluate(-10.0, 10.0, 1000);
+    EXPECT_EQ(function.GetEvaluationCount(), 1000u);
+}
+
+TEST_F(GraphFunctionTest, AdaptiveSamplingFindsDomainEdges) {
+    ASSERT_TRUE(function.SetExpression("sqrt(x)"));
+    RPN::SamplingOptions options;
+    options.initialSamples = 16;
+    auto data = function.EvaluateAdaptive(-1.0, 2.0, options);
+    
+    // Refined down to a quarter pixel next to the edge at 0
+    double xPixel = 3.0 / 1000;
+    ASSERT_FALSE(data->IsEmpty());
+    EXPECT_GE(data->GetX().front(), 0.0);
+    EXPECT_LT(data->GetX().front(), xPixel);
+}
+
+TEST_F(GraphFunctionTest, AdaptiveSamplingRespectsBudget) {
+    ASSERT_TRUE(function.SetExpression("sin(x * x)"));
+    RPN::SamplingOptions options;
+    options.maxSamples = 300;
+    function.ResetEvaluationCount();
+    auto data = function.EvaluateAdaptive(-10.0, 10.0, options);
+    EXPECT_LE(function.GetEvaluationCount(), 300u);
+    EXPECT_LE(data->GetSize(), 300u);
+}
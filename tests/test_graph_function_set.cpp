@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/GraphFunction.h"
+#include "../src/Model/GraphFunctionSet.h"
+#include <string>
+#include <vector>
+
+TEST(GraphFunctionSetTest, MatchesSeparateFunctions) {
+    CalculatorModel calc;
+    calc.defineFunction("dyn", {"dup", "pick"});
+    std::vector<std::string> expressions;
+    for (int k = 1; k <= 12; ++k) {
+        expressions.push_back("sin(x) * " + std::to_string(k) + " + sqrt(abs(x))");
+    }
+    expressions.push_back("x + dyn(x)");
+    
+    RPN::GraphFunctionSet set(&calc);
+    ASSERT_TRUE(set.SetExpressions(expressions)) << set.GetLastError();
+    EXPECT_EQ(set.GetExpressions(), expressions);
+    // sin(x) and sqrt(abs(x)) are shared by the twelve batchable curves,
+    // and sin(x) * 1 is simplified to sin(x)
+    EXPECT_EQ(set.GetOperationCount(), 3u + 12u * 2u - 1u);
+    
+    auto series = set.Evaluate(-4.0, 4.0, 801);
+    ASSERT_EQ(series.size(), expressions.size());
+    EXPECT_EQ(set.GetEvaluationCount(), 801u * expressions.size());
+    for (size_t k = 0; k < expressions.size(); ++k) {
+        RPN::GraphFunction single(&calc);
+        ASSERT_TRUE(single.SetExpression(expressions[k]));
+        auto expected = single.Evaluate(-4.0, 4.0, 801);
+        EXPECT_EQ(series[k]->GetLabel(), expressions[k]);
+        EXPECT_EQ(series[k]->GetX(), expected->GetX());
+        EXPECT_EQ(series[k]->GetY(), expected->GetY()) << expressions[k];
+    }
+    
+    // A bad expression is reported by name and leaves the set alone
+    EXPECT_FALSE(set.SetExpressions({"x + 1", "nosuch(x)"}));
+    EXPECT_NE(set.GetLastError().find("nosuch(x)"), std::string::npos);
+    EXPECT_EQ(set.GetSize(), expressions.size());
+}
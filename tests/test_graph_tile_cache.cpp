@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/GraphFunction.h"
+#include "../src/Model/GraphFunctionSet.h"
+#include "../src/Model/GraphTileCache.h"
+
+TEST(GraphTileCacheTest, EvaluatesOnlyNewTiles) {
+    CalculatorModel calc;
+    RPN::GraphFunction function(&calc);
+    calc.defineFunction("f", {"3", "*"});
+    ASSERT_TRUE(function.SetExpression("f(x) - 1"));
+    RPN::GraphTileCache cache;
+    
+    // 0.01 per pixel samples every 1/128, so a tile spans 2 units and
+    // [0, 10] touches tiles 0 to 5
+    auto data = cache.Sample(function, 0.0, 10.0, 0.01);
+    EXPECT_EQ(cache.GetMisses(), 6u);
+    EXPECT_EQ(function.GetEvaluationCount(), 6 * RPN::GraphTileCache::TILE_SAMPLES);
+    ASSERT_EQ(data->GetSize(), 6 * RPN::GraphTileCache::TILE_SAMPLES);
+    for (size_t i = 0; i < data->GetSize(); ++i) {
+        EXPECT_EQ(data->GetX()[i], i / 128.0);
+        EXPECT_EQ(data->GetY()[i], 3.0 * (i / 128.0) - 1.0);
+    }
+    
+    // Panning within the same tiles is free; further only adds the new ones
+    cache.Sample(function, 1.0, 11.0, 0.01);
+    EXPECT_EQ(cache.GetHits(), 6u);
+    cache.Sample(function, 5.0, 15.0, 0.01);
+    EXPECT_EQ(cache.GetHits(), 10u);
+    EXPECT_EQ(cache.GetMisses(), 8u);
+    EXPECT_EQ(function.GetEvaluationCount(), 8 * RPN::GraphTileCache::TILE_SAMPLES);
+    
+    // A resolution within the same power of two reuses the tiles; zooming
+    // out past it or redefining a function starts over
+    cache.Sample(function, 0.0, 10.0, 0.015);
+    EXPECT_EQ(cache.GetMisses(), 8u);
+    cache.Sample(function, 0.0, 10.0, 0.02);
+    EXPECT_EQ(cache.GetMisses(), 11u);
+    calc.defineFunction("f", {"2", "*"});
+    data = cache.Sample(function, 0.0, 10.0, 0.02);
+    EXPECT_EQ(cache.GetMisses(), 14u);
+    EXPECT_EQ(data->GetY()[1], 2.0 / 64.0 - 1.0);
+}
+
+TEST(GraphTileCacheTest, EvictsLeastRecentlyUsed) {
+    CalculatorModel calc;
+    RPN::GraphFunction function(&calc);
+    ASSERT_TRUE(function.SetExpression("sqrt(x)"));
+    RPN::GraphTileCache cache(4);
+    
+    // Negative tiles are all NaN and left out of the series
+    auto data = cache.Sample(function, -4.0, 3.0, 0.01);
+    EXPECT_EQ(cache.GetMisses(), 4u);
+    EXPECT_EQ(cache.GetSize(), 4u);
+    EXPECT_EQ(data->GetSize(), 2 * RPN::GraphTileCache::TILE_SAMPLES);
+    
+    // Tile -2 is the oldest, so it goes when tile 2 comes in
+    cache.Sample(function, 2.0, 5.0, 0.01);
+    EXPECT_EQ(cache.GetSize(), 4u);
+    cache.Sample(function, -1.5, -0.5, 0.01);
+    EXPECT_EQ(cache.GetHits(), 2u);
+    EXPECT_EQ(cache.GetMisses(), 5u);
+    cache.Sample(function, -3.5, -2.5, 0.01);
+    EXPECT_EQ(cache.GetHits(), 2u);
+    EXPECT_EQ(cache.GetMisses(), 6u);
+    
+    EXPECT_TRUE(cache.Sample(function, 1.0, 1.0, 0.01)->IsEmpty());
+    EXPECT_TRUE(cache.Sample(function, 0.0, 1e9, 1e-6)->IsEmpty());
+    cache.Clear();
+    EXPECT_EQ(cache.GetSize(), 0u);
+}
+
+TEST(GraphTileCacheTest, SamplesSetsTogether) {
+    CalculatorModel calc;
+    RPN::GraphFunction function(&calc);
+    RPN::GraphFunctionSet set(&calc);
+    ASSERT_TRUE(set.SetExpressions({"x * 2", "x * 3"}));
+    RPN::GraphTileCache cache;
+    
+    auto series = cache.Sample(set, 0.0, 10.0, 0.01);
+    ASSERT_EQ(series.size(), 2u);
+    EXPECT_EQ(cache.GetMisses(), 12u);
+    EXPECT_EQ(set.GetEvaluationCount(), 2 * 6 * RPN::GraphTileCache::TILE_SAMPLES);
+    EXPECT_EQ(series[1]->GetY()[128], 3.0);
+    
+    // Adding a curve evaluates the whole set once more; the tiles it
+    // shares with the single-expression path are the same tiles
+    ASSERT_TRUE(set.SetExpressions({"x * 2", "x * 3", "x * 4"}));
+    series = cache.Sample(set, 0.0, 10.0, 0.01);
+    EXPECT_EQ(cache.GetMisses(), 30u);
+    series = cache.Sample(set, 0.0, 10.0, 0.01);
+    EXPECT_EQ(cache.GetHits(), 18u);
+    
+    ASSERT_TRUE(function.SetExpression("x * 4"));
+    cache.Sample(function, 0.0, 10.0, 0.01);
+    EXPECT_EQ(cache.GetHits(), 24u);
+}
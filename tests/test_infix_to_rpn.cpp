@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "../src/Model/InfixToRPN.h"
+#include <string>
+#include <vector>
+
+using RPN::InfixToRPN;
+
+namespace {
+
+std::vector<std::string> rpn(const std::string& infix) {
+    return InfixToRPN::convert(infix);
+}
+
+using Tokens = std::vector<std::string>;
+
+}
+
+TEST(InfixToRPNTest, BinaryOperatorPrecedence) {
+    EXPECT_EQ(rpn("1 + 2 * 3"), (Tokens{"1", "2", "3", "*", "+"}));
+    EXPECT_EQ(rpn("(1 + 2) * 3"), (Tokens{"1", "2", "+", "3", "*"}));
+    EXPECT_EQ(rpn("x - 2 - 3"), (Tokens{"x", "2", "-", "3", "-"}));
+    EXPECT_EQ(rpn("x % 2 ^ 3"), (Tokens{"x", "2", "3", "^", "%"}));
+    EXPECT_EQ(rpn("x*2+1"), (Tokens{"x", "2", "*", "1", "+"}));
+}
+
+TEST(InfixToRPNTest, Functions) {
+    EXPECT_EQ(rpn("sin(x) + sq(x + 1)"), (Tokens{"x", "sin", "x", "1", "+", "sq", "+"}));
+    EXPECT_EQ(rpn("sqrt(abs(x))"), (Tokens{"x", "abs", "sqrt"}));
+    // Builtin functions also apply without parentheses
+    EXPECT_EQ(rpn("sqrt x"), (Tokens{"x", "sqrt"}));
+}
+
+TEST(InfixToRPNTest, UnaryMinus) {
+    EXPECT_EQ(rpn("-x"), (Tokens{"x", "+/-"}));
+    EXPECT_EQ(rpn("2 * -x"), (Tokens{"2", "x", "+/-", "*"}));
+    EXPECT_EQ(rpn("-x ^ 2"), (Tokens{"x", "2", "^", "+/-"}));
+    EXPECT_EQ(rpn("-x * 2"), (Tokens{"x", "+/-", "2", "*"}));
+    EXPECT_EQ(rpn("2 ^ -x"), (Tokens{"2", "x", "+/-", "^"}));
+    EXPECT_EQ(rpn("x - -1"), (Tokens{"x", "1", "+/-", "-"}));
+    EXPECT_EQ(rpn("(-x)"), (Tokens{"x", "+/-"}));
+    EXPECT_EQ(rpn("+x"), (Tokens{"x"}));
+}
+
+TEST(InfixToRPNTest, NumericLiterals) {
+    EXPECT_EQ(rpn("1e-5 * x"), (Tokens{"1e-5", "x", "*"}));
+    EXPECT_EQ(rpn("0x1p-2+x"), (Tokens{"0x1p-2", "x", "+"}));
+    // Only an exponent keeps its sign
+    EXPECT_EQ(rpn("0x1e-3"), (Tokens{"0x1e", "3", "-"}));
+
+    InfixToRPN parser;
+    ASSERT_TRUE(parser.parse("2.5e1 - x"));
+    ASSERT_EQ(parser.tokens().size(), 3u);
+    EXPECT_EQ(parser.tokens()[0].kind, InfixToRPN::TokenKind::NUMBER);
+    EXPECT_EQ(parser.tokens()[0].value, 25.0);
+    EXPECT_EQ(parser.tokens()[1].kind, InfixToRPN::TokenKind::IDENTIFIER);
+    EXPECT_EQ(parser.tokens()[2].op, RPN::Builtin::Subtract);
+}
+
+TEST(InfixToRPNTest, RejectsUnbalancedParentheses) {
+    InfixToRPN parser;
+    EXPECT_FALSE(parser.parse("(x + 1"));
+    EXPECT_FALSE(parser.parse("x + 1)"));
+    EXPECT_TRUE(rpn("sin(x").empty());
+    EXPECT_TRUE(parser.parse("((x))"));
+}
+
+TEST(InfixToRPNTest, ReusesBuffers) {
+    InfixToRPN parser;
+    ASSERT_TRUE(parser.parse("sin(x) * (x + 2) - -x ^ 2"));
+    const auto* storage = parser.tokens().data();
+    ASSERT_TRUE(parser.parse("x + 1"));
+    EXPECT_EQ(parser.tokens().data(), storage);
+    EXPECT_EQ(parser.tokens().size(), 3u);
+}
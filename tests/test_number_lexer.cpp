@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "../src/Model/NumberLexer.h"
+#include <cmath>
+
+using RPN::parseNumber;
+
+TEST(NumberLexerTest, DecimalLiterals) {
+    double value = 0.0;
+    EXPECT_TRUE(parseNumber("42", value));
+    EXPECT_EQ(value, 42.0);
+    EXPECT_TRUE(parseNumber("-3.25", value));
+    EXPECT_EQ(value, -3.25);
+    EXPECT_TRUE(parseNumber("+.5", value));
+    EXPECT_EQ(value, 0.5);
+    EXPECT_TRUE(parseNumber("1.5e3", value));
+    EXPECT_EQ(value, 1500.0);
+    EXPECT_TRUE(parseNumber("2E-2", value));
+    EXPECT_DOUBLE_EQ(value, 0.02);
+}
+
+TEST(NumberLexerTest, HexLiterals) {
+    double value = 0.0;
+    EXPECT_TRUE(parseNumber("0xff", value));
+    EXPECT_EQ(value, 255.0);
+    EXPECT_TRUE(parseNumber("-0X10", value));
+    EXPECT_EQ(value, -16.0);
+    EXPECT_TRUE(parseNumber("0x1.8p1", value));
+    EXPECT_EQ(value, 3.0);
+    EXPECT_FALSE(parseNumber("0x", value));
+    EXPECT_FALSE(parseNumber("0xg", value));
+}
+
+TEST(NumberLexerTest, SpecialValues) {
+    double value = 0.0;
+    EXPECT_TRUE(parseNumber("inf", value));
+    EXPECT_TRUE(std::isinf(value) && value > 0);
+    EXPECT_TRUE(parseNumber("-infinity", value));
+    EXPECT_TRUE(std::isinf(value) && value < 0);
+    EXPECT_TRUE(parseNumber("nan", value));
+    EXPECT_TRUE(std::isnan(value));
+}
+
+TEST(NumberLexerTest, RejectsPartialAndNonNumbers) {
+    double value = 7.0;
+    EXPECT_FALSE(parseNumber("", value));
+    EXPECT_FALSE(parseNumber("-", value));
+    EXPECT_FALSE(parseNumber("+-1", value));
+    EXPECT_FALSE(parseNumber("1/x", value));
+    EXPECT_FALSE(parseNumber("+/-", value));
+    EXPECT_FALSE(parseNumber("3abc", value));
+    EXPECT_FALSE(parseNumber(" 3", value));
+    EXPECT_FALSE(parseNumber("dup", value));
+    EXPECT_FALSE(parseNumber("1e999", value));
+    EXPECT_FALSE(parseNumber("0x-1", value));
+    EXPECT_FALSE(parseNumber("-0x-1", value));
+    EXPECT_FALSE(parseNumber("0x+1", value));
+    EXPECT_EQ(value, 7.0);
+}
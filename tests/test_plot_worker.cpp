@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/GraphFunction.h"
+#include "../src/Model/GraphTileCache.h"
+#include "../src/Model/PlotWorker.h"
+#include <chrono>
+#include <thread>
+
+namespace {
+
+bool waitIdle(const RPN::PlotWorker& worker) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (worker.IsBusy()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}
+
+TEST(PlotWorkerTest, PublishesFinalPass) {
+    CalculatorModel calc;
+    RPN::GraphFunction function(&calc);
+    calc.defineFunction("f", {"3", "*"});
+    RPN::PlotWorker worker;
+    
+    uint64_t job = worker.Submit({{"f(x) + sin(x)"}, calc.snapshotFunctions(), 0.0, 10.0, 1000});
+    // Redefining on this thread does not affect the job, which runs on
+    // the snapshot it was given
+    calc.defineFunction("f", {"4", "*"});
+    ASSERT_TRUE(waitIdle(worker));
+    
+    RPN::PlotWorker::Result result;
+    ASSERT_TRUE(worker.TakeResult(result));
+    EXPECT_EQ(result.job, job);
+    EXPECT_TRUE(result.final);
+    EXPECT_TRUE(result.error.empty());
+    
+    // Same grid and values as the tile cache gives on this thread
+    calc.defineFunction("f", {"3", "*"});
+    ASSERT_TRUE(function.SetExpression("f(x) + sin(x)"));
+    RPN::GraphTileCache cache;
+    auto expected = cache.Sample(function, 0.0, 10.0, 0.01);
+    EXPECT_EQ(result.series[0]->GetX(), expected->GetX());
+    EXPECT_EQ(result.series[0]->GetY(), expected->GetY());
+    // Both passes were evaluated for the expression
+    EXPECT_GT(result.evaluationCount, expected->GetSize());
+    
+    EXPECT_FALSE(worker.TakeResult(result));
+}
+
+TEST(PlotWorkerTest, DropsSupersededJobs) {
+    CalculatorModel calc;
+    RPN::PlotWorker worker;
+    auto functions = calc.snapshotFunctions();
+    
+    worker.Submit({{"sin(x)"}, functions, -1e4, 1e4, 4000});
+    uint64_t last = worker.Submit({{"cos(x)"}, functions, 0.0, 1.0, 100});
+    ASSERT_TRUE(waitIdle(worker));
+    RPN::PlotWorker::Result result;
+    ASSERT_TRUE(worker.TakeResult(result));
+    EXPECT_EQ(result.job, last);
+    EXPECT_EQ(result.series[0]->GetLabel(), "cos(x)");
+    
+    worker.Submit({{"sin(x)"}, functions, -1e4, 1e4, 4000});
+    worker.Cancel();
+    ASSERT_TRUE(waitIdle(worker));
+    EXPECT_FALSE(worker.TakeResult(result));
+    
+    worker.Submit({{"nosuch(x)"}, functions, 0.0, 1.0, 100});
+    ASSERT_TRUE(waitIdle(worker));
+    ASSERT_TRUE(worker.TakeResult(result));
+    EXPECT_TRUE(result.final);
+    EXPECT_FALSE(result.error.empty());
+}
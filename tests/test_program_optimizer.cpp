@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include "../src/Model/CalculatorModel.h"
+#include "../src/Model/EvaluationContext.h"
+#include "../src/Model/FunctionTable.h"
+#include "../src/Model/NumberLexer.h"
+#include "../src/Model/ProgramOptimizer.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using RPN::Builtin;
+using RPN::OpCode;
+
+namespace {
+
+// Compiles a body the way CalculatorModel does, without optimizing it
+RPN::Program compile(const std::vector<std::string>& body) {
+    RPN::Program code;
+    for (const std::string& token : body) {
+        double value;
+        Builtin op;
+        if (RPN::parseNumber(token, value)) {
+            code.push_back({OpCode::PUSH, 0, value});
+        } else if (RPN::findBuiltin(token, op)) {
+            code.push_back({OpCode::BUILTIN, static_cast<uint32_t>(op), 0.0});
+        } else {
+            ADD_FAILURE() << "Not a literal or builtin: " << token;
+        }
+    }
+    return code;
+}
+
+struct Outcome {
+    bool ok;
+    std::vector<uint64_t> stack;
+};
+
+Outcome run(const RPN::Program& program, const std::vector<double>& initial) {
+    RPN::EvaluationContext context(std::make_shared<const RPN::FunctionTable>());
+    for (double value : initial) {
+        context.pushValue(value);
+    }
+    Outcome outcome{context.run(program), {}};
+    const auto& stack = context.getStack();
+    for (size_t i = 0; i < stack.size(); ++i) {
+        uint64_t bits;
+        double value = stack[i];
+        std::memcpy(&bits, &value, sizeof(bits));
+        outcome.stack.push_back(bits);
+    }
+    return outcome;
+}
+
+std::string describe(const std::vector<std::string>& body, const std::vector<double>& initial) {
+    std::ostringstream text;
+    text << "stack:";
+    for (double value : initial) {
+        text << " " << value;
+    }
+    text << "  body:";
+    for (const std::string& token : body) {
+        text << " " << token;
+    }
+    return text.str();
+}
+
+}
+
+TEST(ProgramOptimizerTest, FoldsConstants) {
+    RPN::Program code = RPN::optimizeProgram(compile({"2", "3", "*", "*"}));
+    ASSERT_EQ(code.size(), 2u);
+    EXPECT_EQ(code[0].code, OpCode::PUSH);
+    EXPECT_DOUBLE_EQ(code[0].value, 6.0);
+    EXPECT_EQ(code[1].index, static_cast<uint32_t>(Builtin::Multiply));
+
+    code = RPN::optimizeProgram(compile({"1", "2", "swap", "-", "4", "dup", "*", "+"}));
+    ASSERT_EQ(code.size(), 1u);
+    EXPECT_DOUBLE_EQ(code[0].value, 17.0);
+
+    // Failing operations are left to report their error when run
+    EXPECT_EQ(RPN::optimizeProgram(compile({"1", "0", "/"})).size(), 3u);
+    EXPECT_EQ(RPN::optimizeProgram(compile({"-4", "sqrt"})).size(), 2u);
+}
+
+TEST(ProgramOptimizerTest, RemovesShufflesThatCancel) {
+    EXPECT_EQ(RPN::optimizeProgram(compile({"swap", "swap", "-"})).size(), 1u);
+    EXPECT_EQ(RPN::optimizeProgram(compile({"rot", "rot", "rot", "+", "+"})).size(), 2u);
+    EXPECT_EQ(RPN::optimizeProgram(compile({"dup", "drop", "sin"})).size(), 1u);
+    EXPECT_EQ(RPN::optimizeProgram(compile({"swap", "*"})).size(), 1u);
+
+    // Here the shuffle is the only thing that needs two values, so
+    // dropping it would let a one-value stack through without an error
+    EXPECT_EQ(RPN::optimizeProgram(compile({"swap", "swap", "sin"})).size(), 3u);
+}
+
+TEST(ProgramOptimizerTest, FusesSquareAndMultiplyAdd) {
+    RPN::Program code = RPN::optimizeProgram(compile({"dup", "*"}));
+    ASSERT_EQ(code.size(), 1u);
+    EXPECT_EQ(code[0].code, OpCode::SQUARE);
+
+    code = RPN::optimizeProgram(compile({"*", "0.5", "+"}));
+    ASSERT_EQ(code.size(), 1u);
+    EXPECT_EQ(code[0].code, OpCode::MULTIPLY_ADD);
+    EXPECT_DOUBLE_EQ(code[0].value, 0.5);
+
+    // Both keep the error of the operation they replace
+    RPN::EvaluationContext context(std::make_shared<const RPN::FunctionTable>());
+    context.pushValue(1.0);
+    EXPECT_FALSE(context.run(code));
+    EXPECT_EQ(context.getError(), "Need at least 2 values on stack");
+}
+
+TEST(ProgramOptimizerTest, MatchesUnoptimizedInterpreter) {
+    // Some products are inexact, so a multiply-add contracted into one
+    // rounding would differ from * then +. The phrases make the fused
+    // instructions common enough to show it.
+    const std::vector<std::vector<std::string>> phrases = {
+        {"0"}, {"1"}, {"2"}, {"-1"}, {"0.5"}, {"3"}, {"0.1"}, {"0.7"},
+        {"+"}, {"-"}, {"*"}, {"/"}, {"^"}, {"mod"}, {"sqrt"}, {"+/-"}, {"ln"}, {"min"}, {">"},
+        {"dup"}, {"drop"}, {"swap"}, {"rot"}, {"over"}, {"pick"}, {"roll"},
+        {"*", "0.7", "+"}, {"*", "0.1", "+"}, {"dup", "*"},
+    };
+    const std::vector<double> values = {0.0, 1.0, -2.0, 0.25, 3.0, 1e300, 0.1, 1.1, 1.3, 1.0 / 3.0};
+
+    std::mt19937 random(12345);
+    std::uniform_int_distribution<size_t> phrase(0, phrases.size() - 1);
+    std::uniform_int_distribution<size_t> value(0, values.size() - 1);
+    std::uniform_int_distribution<size_t> length(1, 10);
+    std::uniform_int_distribution<size_t> depth(0, 4);
+
+    size_t succeeded = 0;
+    size_t changed = 0;
+    for (int trial = 0; trial < 20000; ++trial) {
+        std::vector<std::string> body;
+        for (size_t n = length(random); body.size() < n;) {
+            const std::vector<std::string>& tokens = phrases[phrase(random)];
+            body.insert(body.end(), tokens.begin(), tokens.end());
+        }
+        std::vector<double> initial(depth(random));
+        for (double& v : initial) {
+            v = values[value(random)];
+        }
+
+        RPN::Program code = compile(body);
+        RPN::Program optimized = RPN::optimizeProgram(code);
+        changed += optimized.size() != code.size();
+
+        Outcome expected = run(code, initial);
+        Outcome actual = run(optimized, initial);
+        ASSERT_EQ(actual.ok, expected.ok) << describe(body, initial);
+        if (expected.ok) {
+            ++succeeded;
+            ASSERT_EQ(actual.stack, expected.stack) << describe(body, initial);
+        }
+    }
+    // Make sure the trials cover both outcomes and actually rewrite code
+    EXPECT_GT(succeeded, 1000u);
+    EXPECT_GT(changed, 1000u);
+}
+
+TEST(ProgramOptimizerTest, DefinedFunctionsAreOptimized) {
+    CalculatorModel calc;
+    calc.defineFunction("scale", {"2", "3", "*", "*"});
+    calc.defineFunction("sq", {"dup", "*"});
+    uint32_t slot;
+    ASSERT_TRUE(calc.findFunction("scale", slot));
+    EXPECT_EQ(calc.getFunctions()[slot].code.size(), 2u);
+    ASSERT_TRUE(calc.findFunction("sq", slot));
+    EXPECT_EQ(calc.getFunctions()[slot].code.size(), 1u);
+
+    calc.pushValue(1.5);
+    ASSERT_TRUE(calc.executeFunction("scale"));
+    ASSERT_TRUE(calc.executeFunction("sq"));
+    double result;
+    ASSERT_TRUE(calc.popValue(result));
+    EXPECT_DOUBLE_EQ(result, 81.0);
+}
@@ -0,0 +1,24 @@
+#include <gtest/gtest.h>
+#include "../src/Model/ThreadPool.h"
+#include <vector>
+
+TEST(ThreadPoolTest, ParallelForCoversEveryIndexOnce) {
+    RPN::ThreadPool pool(3);
+    std::vector<int> hits(10007, 0);
+    std::vector<size_t> perWorker(pool.size(), 0);
+    pool.parallelFor(hits.size(), 100, [&](size_t begin, size_t end, unsigned worker) {
+        for (size_t i = begin; i < end; ++i) {
+            ++hits[i];
+        }
+        perWorker[worker] += end - begin;
+    });
+    
+    for (int count : hits) {
+        ASSERT_EQ(count, 1);
+    }
+    size_t total = 0;
+    for (size_t n : perWorker) {
+        total += n;
+    }
+    EXPECT_EQ(total, hits.size());
+}